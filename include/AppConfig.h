@@ -7,14 +7,35 @@ struct AppConfig {
     std::string transport_protocol, server_address;
     unsigned short port;
     unsigned short timeout;
+    unsigned int connect_timeout; // Milliseconds for name resolution and TCP connect
     unsigned char retransmissions_number;
+    unsigned short window_size; // Maximum number of unconfirmed UDP messages in flight
+    unsigned short batch_size; // Maximum number of UDP datagrams per recvmmsg()/sendmmsg()
+    std::string io_backend; // UDP socket I/O, "batch" or "uring"
+    bool latency; // Record round-trip and output latency histograms
+    unsigned short reconnect_attempts; // Reconnects after a lost connection before giving up, 0 for none
+    std::string script_path; // Input lines are taken from this file (-f) instead of stdin, empty for stdin
+    unsigned int script_rate; // Script lines per second, 0 for as fast as the protocol allows
+    std::string transcript_path; // Every message is logged here by a writer thread (-T), empty for none
+    unsigned int transcript_rotate; // MiB after which the transcript is rotated, 0 for never
+    std::string transcript_fsync; // "none", "rotate" or "batch"
+    std::string trace_path; // Protocol trace written by /trace and on fatal errors, empty for none
     bool show_help;
     bool valid; // Add a flag to indicate if the config is valid
 
     AppConfig() 
         : port(4567), 
           timeout(250), 
+          connect_timeout(5000), 
           retransmissions_number(3), 
+          window_size(1), 
+          batch_size(16), 
+          io_backend("batch"), 
+          latency(false), 
+          reconnect_attempts(0), 
+          script_rate(0), 
+          transcript_rotate(0), 
+          transcript_fsync("rotate"), 
           show_help(false), 
           valid(true) 
     {}
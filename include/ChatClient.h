@@ -1,57 +1,212 @@
 #ifndef CHATCLIENT_H
 #define CHATCLIENT_H
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <random>
+
 #include "AppConfig.h"
 #include "Messages.h"
+#include "LineFramer.h"
+#include "SendWindow.h"
+#include "SeenIds.h"
+#include "TimerQueue.h"
+#include "RttEstimator.h"
+#include "DatagramIO.h"
+#include "OutputSink.h"
+#include "InputReader.h"
+#include "ScriptFile.h"
+#include "CommandQueue.h"
+#include "Reactor.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+#include "TraceRing.h"
+#include "Transcript.h"
+#include "Connector.h"
+
+// Gets what a session received, for tools that drive sessions without a terminal
+class SessionObserver {
+public:
+    virtual ~SessionObserver() = default;
 
-enum class MessageType {
-    CONFIRM,
-    ERR,
-    BYE,
-    MSG,
-    REPLY,
-    UNKNOWN
+    virtual void onReply(bool success, std::string_view content) {}
+    virtual void onMessage(std::string_view display_name, std::string_view content) {}
 };
 
-class ChatClient {
+// One chat session, driven by a Reactor together with any number of other sessions
+class ChatClient : public EventHandler {
 private:
     AppConfig config;
+    SessionObserver* observer;
+    OutputSink terminal; // Buffered stdout and stderr
+    std::unique_ptr<InputReader> input; // Lines from the input descriptor, only for sessions attached to one
+    CommandQueue command_queue; // Commands waiting for a server response
     int server_socket;
     uint16_t mid;
     std::string username, display_name, secret;
-    bool waiting_for_response, waiting_for_confirm, bye, err, tcp, connect_err, waiting_for_auth;
-    struct sockaddr_in * their_addr;
+    bool waiting_for_response, bye, err, tcp, connect_err, waiting_for_auth;
+    struct sockaddr_storage their_addr; // UDP destination, follows the sender of the last datagram
+    std::vector<Endpoint> candidates; // Resolved UDP server addresses, tried in turn until one answers
+    size_t candidate;
+    bool server_answered; // A datagram arrived, their_addr is settled
 
-    const std::chrono::milliseconds TIMEOUT;
+    RttEstimator rtt; // Adaptive retransmission timeout, -d is the initial value
     const int MAX_RETRIES;
 
-    TimedMessage pending;
+    SendWindow window; // Unconfirmed UDP messages
+    std::unique_ptr<DatagramIO> udp_io; // UDP socket backend, created with the socket
+    SeenIds seen_ids;  // UDP messages already received from the server
+    TimerQueue timers; // Retransmission deadlines of the messages in window
+
+    int timer_fd; // timerfd armed to the earliest retransmission deadline
+    std::chrono::steady_clock::time_point armed_deadline;
+    LineFramer framer; // TCP receive buffer
+
+    std::array<std::byte, MAX_MESSAGE_SIZE> send_buffer; // Outgoing messages are serialized here
+    MsgMessage outgoing_msg;
+
+    Reactor* reactor; // Set while attached
+    int io_fd; // Readable when something was received, socket or io_uring ring
+    int input_fd;
+    bool input_pollable; // False for regular files, epoll refuses them but they never block
+    bool input_watched;  // input_fd is registered in the reactor
+    bool input_blocked;  // Command queue is full, input is not read
+    size_t input_dropped; // Overlong input lines already reported
+
+    // After end of input the server gets this long to answer what is left, renewed by everything it sends.
+    // -c, for UDP at least as long as the retransmissions of the last message take.
+    const std::chrono::milliseconds drain_timeout;
+    std::chrono::steady_clock::time_point drain_deadline; // max() until input ended
+    bool done;
+    int exit_status;
+    std::atomic<bool> interrupted;
+
+    // Histograms of the latency mode (-l)
+    struct Latency {
+        LatencyHistogram confirm; // UDP message first sent -> its CONFIRM
+        LatencyHistogram reply;   // AUTH or JOIN sent -> REPLY
+        LatencyHistogram output;  // MSG received -> written to stdout
+        std::chrono::steady_clock::time_point last_sent, request_sent, received;
+        // Arrivals of MSGs still in the output buffer. Fixed size, while stdout is blocked
+        // and it is full, further MSGs are not sampled.
+        std::array<std::chrono::steady_clock::time_point, 1024> unwritten;
+        size_t unwritten_count = 0;
+
+        void arrived() {
+            if (unwritten_count < unwritten.size()) unwritten[unwritten_count++] = received;
+        }
+    };
+    std::unique_ptr<Latency> latency; // Only allocated in the latency mode
+
+    Metrics metrics;
+    std::chrono::steady_clock::time_point auth_sent;
+
+    TraceRing trace; // Last protocol events, dumped by /trace and on fatal errors
+    std::unique_ptr<Transcript> transcript; // Only with -T
+    uint32_t traced_state;
+
+    // Resilient mode (-R): a lost connection is made again and the session replayed on it
+    // Backoff after the first failed attempt, long enough that a restarting server can come back
+    // within a few attempts: 5 of them span at least 0.75 s, 10 at least 10 s
+    static constexpr std::chrono::milliseconds RECONNECT_MIN{100};
+    static constexpr std::chrono::milliseconds RECONNECT_MAX{5000}; // Backoff never grows beyond this
+    bool lost;         // Connection failed, recover() makes a new one once reconnect_at passed
+    bool recovering;   // Reconnected, waiting for the REPLY to the replayed AUTH
+    bool replay_auth;  // AUTH is sent again after reconnecting
+    unsigned reconnect_attempts; // Since the connection was lost, reset when the session is back
+    std::chrono::steady_clock::time_point lost_at, reconnect_at;
+    std::string channel, joined_channel; // Requested by the last JOIN, and the last one the server accepted
+    std::minstd_rand jitter;
+
+    // Script mode (-f): lines are taken from a mapped file whenever a command could be sent
+    std::unique_ptr<ScriptFile> script;
+    std::chrono::nanoseconds script_interval; // Between two lines with --rate, zero without
+    std::chrono::steady_clock::time_point script_started, script_next; // Pacing: next line is due at script_next
 
-    bool sendMessage(const std::string& message);
-    bool sendMessage(const std::vector<uint8_t>& message); // For UDP
+    bool sendMessage(std::span<const std::byte> message); // TCP stream or UDP waiting for CONFIRM
+    bool sendTracked(std::span<const std::byte> message); // For UDP, waits for CONFIRM
+    bool sendDatagram(std::span<const std::byte> message); // For UDP, fire and forget
+    bool flushOutbox(); // Sends all queued UDP datagrams at once
+    bool nextCandidate(); // Moves their_addr to the next resolved address while the server didn't answer yet
+    void candidateRefused(); // ICMP error for their_addr, unacknowledged messages go to the next address
+    bool sendSerialized(size_t length); // Sends first `length` bytes of send_buffer
     void receiveMessage();
-    void processMessage(const std::string& message);
-    void processMessage(const std::vector<uint8_t>& message);
+    void processMessage(std::string_view message);
+    void processMessage(std::span<const uint8_t> message);
+    void rejectMessage(std::span<const uint8_t> message); // Unknown or malformed UDP message
+    void handleReply(bool success, std::string_view content); // REPLY of either variant
 
     bool sendAuthMessage(const std::string& username, const std::string& display_name, const std::string& secret);
     bool sendJoinMessage(const std::string& channelID, const std::string& display_name);
-    bool sendMsgMessage(const std::string& display_name, const std::string& content);
+    bool sendMsgMessage(const std::string& display_name, std::string_view content);
     bool sendByeMessage();
     bool sendConfirmMessage(const uint16_t message_id);
+    bool confirmIncoming(const uint16_t message_id);
     void printHelp();
+    void printStats(); // Transcript and latency summaries of the opt-in modes, printed when the session ends
+    void printLatency();
+    void printMetrics();
+    void updateGauges(); // Gauges are refreshed once per event loop iteration
+    void traceState(); // Records a STATE event if the state changed
+    void transcribe(bool received, MessageType type, std::string_view name, std::string_view text);
+    bool dumpTrace(std::string_view path); // Empty path means the configured one
+    void flushTerminal(bool due_only = false); // Also records output latency of what was written
 
-    void processCommand(const std::string& input);
-
-    MessageType determineMessageType(const std::string& message);
-    MessageType determineMessageType(const std::vector<uint8_t>& message);
+    bool handleInput(std::string_view line); // Processes or queues one line of user input, false if the queue is full
+    void processCommand(const Command& command);
 
     bool checkForTimeouts();
+    void armTimer();
+
+    void readInput();
+    void takeInput(); // Processes queued commands and lines read so far
+    void takeScript(); // Script lines, as many as the protocol and --rate allow
+    void printScriptSummary();
+    void watchInput(bool watch);
+    bool inputEnded() const; // stdin or the script has no more lines
+    void finish(int status);
+    void detach();
+
+    void connectionLost(); // Fatal without -R, otherwise schedules a reconnect
+    void recover(); // Drops the lost connection and reconnects once the backoff expired
+    void dropConnection();
+    // New connection with AUTH replayed, false if the server can't be reached.
+    // Connects synchronously like at startup, so the reactor stalls for up to -c meanwhile.
+    bool reconnect();
+    void requeueUnsent(); // JOIN, unconfirmed MSGs and queued commands go again after the replayed AUTH
+    void recovered(); // Reports how long the recovery took
+    std::chrono::microseconds backoff(); // Capped exponential, with jitter
 
 public:
-    ChatClient(const AppConfig& config);
+    ChatClient(const AppConfig& config, SessionObserver* observer = nullptr);
     ~ChatClient();
 
-    int runCLI();
+    int runCLI(); // Runs this session alone, attached to stdin or to the -f script
+
+    // Registers the session in reactor, lines are read from input_fd unless it's -1
+    bool attach(Reactor& reactor, int input_fd = -1);
+
+    // Handles line as if it was read from the input, false if the command queue is full
+    bool submitLine(std::string_view line);
+
+    void mute(); // Drops terminal output
+
+    bool finished() const;
+    bool idle() const; // Every command was sent and confirmed
+    int exitStatus() const;
+
+    // Stops the reactor, safe to call from a signal handler
+    void interrupt();
+
+    // Writes metrics as key=value pairs to fd, safe to call from a signal handler
+    void dumpMetrics(int fd) const;
+
+    void onEvent(int fd, uint32_t events) override;
+    void afterEvents() override;
+
+    static MessageType determineMessageType(std::span<const uint8_t> message); // Type of a UDP datagram
+
     bool connectToServer();
     void closeConnection();
 };
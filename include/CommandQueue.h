@@ -0,0 +1,63 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <cstddef>
+#include <string_view>
+
+enum class CommandType {
+    AUTH,    // /auth <Username> <Secret> <DisplayName>
+    JOIN,    // /join <ChannelID>
+    RENAME,  // /rename <DisplayName>
+    HELP,    // /help
+    LATENCY, // /latency
+    STATS,   // /stats
+    TRACE,   // /trace [file]
+    MSG,     // Anything not starting with '/'
+    INVALID  // Unknown command or wrong parameters
+};
+
+// One line of user input, parsed once. Views point either into the input
+// buffer or into the arena of CommandQueue.
+struct Command {
+    CommandType type = CommandType::INVALID;
+    std::string_view name;      // First word of the line
+    std::string_view params[3];
+    std::string_view text;      // Whole line
+
+    static Command parse(std::string_view line);
+};
+
+// Fixed-size FIFO of parsed commands waiting for the server. Lines are copied
+// into a byte ring, so the queue never allocates and its memory use is constant.
+class CommandQueue {
+public:
+    static constexpr size_t CAPACITY = 1024;        // Commands
+    static constexpr size_t ARENA_SIZE = 256 * 1024; // Bytes of queued lines
+
+    CommandQueue();
+
+    // Copies the command, false if there is no room for it (caller keeps it and retries later)
+    bool push(const Command& command);
+    const Command& front() const;
+    void pop();
+
+    bool empty() const;
+    size_t size() const;
+    size_t highWater() const; // Largest size ever reached
+
+private:
+    struct Entry {
+        Command command;
+        size_t offset, length; // Copy of the line in the arena
+    };
+
+    Entry entries[CAPACITY];
+    size_t first, count;
+    char arena[ARENA_SIZE];
+    size_t arena_head, arena_tail; // Oldest used byte, next free byte
+    size_t high_water;
+
+    bool reserve(size_t length, size_t& offset);
+};
+
+#endif // COMMANDQUEUE_H
@@ -0,0 +1,67 @@
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// One resolved server address of either family
+struct Endpoint {
+    struct sockaddr_storage addr;
+    socklen_t length;
+};
+
+// Dotted or colon notation of addr, for messages
+std::string addressString(const struct sockaddr_storage& addr);
+
+// Finds the server Happy Eyeballs style (RFC 8305). IPv6 and IPv4 addresses are looked up in parallel
+// by background threads, so a slow resolver only delays its own family, and they are tried alternately,
+// IPv6 first. Connection attempts overlap, the first one that succeeds wins.
+class Connector {
+public:
+    static constexpr std::chrono::milliseconds RESOLUTION_DELAY{50}; // Wait for IPv6 after IPv4 arrived
+    static constexpr std::chrono::milliseconds ATTEMPT_DELAY{250};   // Next connect() starts after this
+
+    // timeout limits the whole resolve() or connect()
+    Connector(const std::string& host, unsigned short port, std::chrono::milliseconds timeout);
+    ~Connector();
+
+    // Addresses of the server in the order they should be tried, empty on failure.
+    // Waits for the other family at most RESOLUTION_DELAY after the first one arrived.
+    std::vector<Endpoint> resolve();
+
+    // Blocking TCP socket connected to the fastest address, -1 on failure
+    int connect();
+
+    // Why resolve() or connect() failed
+    const std::string& error() const;
+
+    // addr as an IPv4-mapped IPv6 address, for dual-stack sockets
+    static Endpoint mapped(const Endpoint& endpoint);
+
+private:
+    struct Lookup; // Shared with the resolver threads, which may outlive this object
+
+    std::shared_ptr<Lookup> lookup;
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<Endpoint> queue[2]; // Addresses not tried yet, IPv6 and IPv4
+    size_t taken[2];   // Addresses of each family already moved to queue
+    int next_family;   // Family of the next attempt, alternates when both have addresses
+    bool finished[2];  // Lookups seen finished by collect()
+    int status[2];
+    std::chrono::steady_clock::time_point resolved_at[2];
+    std::string failure;
+
+    // Body of a resolver thread, index 0 looks up IPv6 and 1 IPv4
+    static void lookUp(std::shared_ptr<Lookup> lookup, std::string host, std::string port, int index);
+
+    bool collect(); // Moves newly resolved addresses to queue, true when both lookups finished
+    std::string lookupError() const; // Why no address was found
+    bool take(Endpoint& endpoint); // Next address to try
+    int waitMs(std::chrono::steady_clock::time_point until) const; // poll() timeout up to until or deadline
+};
+
+#endif // CONNECTOR_H
@@ -0,0 +1,60 @@
+#ifndef DATAGRAMBATCH_H
+#define DATAGRAMBATCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "DatagramIO.h"
+
+// Batched UDP I/O. Datagrams are drained from the socket with one recvmmsg()
+// and everything queued while processing them goes out with one sendmmsg().
+class DatagramBatch : public DatagramIO {
+public:
+    static constexpr size_t RECV_SLOT_SIZE = 4096;  // Valid IPK24 datagrams are below 1500 bytes
+    static constexpr size_t SEND_ARENA_SIZE = 65536;
+
+    explicit DatagramBatch(size_t batch_size);
+
+    size_t batchSize() const;
+
+    bool start(int fd) override;
+    int pollFd() const override;
+
+    // Receives up to batchSize() datagrams without blocking, returns their count or -1
+    int receive(int fd) override;
+    std::span<const uint8_t> datagram(int index) const override;
+    const struct sockaddr_storage& sender(int index) const override;
+    bool truncated(int index) const override;
+
+    bool queue(std::span<const std::byte> data) override;
+    bool pending() const override;
+
+    // Sends every queued datagram to dest, false if sendmmsg() failed
+    bool flush(int fd, const struct sockaddr_storage& dest) override;
+
+    const Stats& stats() const override;
+    const char* name() const override;
+
+private:
+    size_t batch_size;
+    int socket_fd;
+
+    std::vector<uint8_t> recv_data;
+    std::vector<struct sockaddr_storage> recv_addr;
+    std::vector<struct iovec> recv_iov;
+    std::vector<struct mmsghdr> recv_msgs;
+
+    std::vector<std::byte> send_data;
+    size_t send_used;
+    std::vector<struct iovec> send_iov;
+    std::vector<struct mmsghdr> send_msgs;
+    size_t send_count;
+
+    Stats counters;
+};
+
+#endif // DATAGRAMBATCH_H
@@ -0,0 +1,57 @@
+#ifndef DATAGRAMIO_H
+#define DATAGRAMIO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <netinet/in.h>
+
+// UDP socket I/O backend of ChatClient. Received datagrams are handed out in batches,
+// outgoing ones are queued and sent together by flush(). Backends print nothing,
+// failures are returned with errno set and reported by the session.
+class DatagramIO {
+public:
+    struct Stats {
+        uint64_t recv_calls = 0, recv_datagrams = 0;
+        uint64_t send_calls = 0, send_datagrams = 0;
+    };
+
+    virtual ~DatagramIO() = default;
+
+    // Prepares I/O on the socket, false if this backend can't be used
+    virtual bool start(int fd) = 0;
+
+    // Descriptor the event loop should wait on for incoming datagrams
+    virtual int pollFd() const = 0;
+
+    // Takes received datagrams without blocking, returns their count or -1.
+    // Datagrams stay valid until the next receive().
+    virtual int receive(int fd) = 0;
+    virtual std::span<const uint8_t> datagram(int index) const = 0;
+    virtual const struct sockaddr_storage& sender(int index) const = 0;
+    virtual bool truncated(int index) const = 0;
+
+    // Copies a datagram into the outbox, false if it is full and has to be flushed first
+    virtual bool queue(std::span<const std::byte> data) = 0;
+    virtual bool pending() const = 0;
+
+    // Sends every queued datagram to dest of either family, false on failure.
+    // Sends that complete asynchronously fail the next call.
+    virtual bool flush(int fd, const struct sockaddr_storage& dest) = 0;
+
+    virtual const Stats& stats() const = 0;
+    virtual const char* name() const = 0;
+
+    // Started backend for the socket, "batch" (recvmmsg()/sendmmsg()) or "uring".
+    // nullptr if the kernel lacks support for it, the caller may fall back to "batch".
+    static std::unique_ptr<DatagramIO> create(const std::string& backend, size_t batch_size, int fd);
+};
+
+// Length of the address in addr, as expected by sendmsg()
+inline socklen_t addressLength(const struct sockaddr_storage& addr) {
+    return addr.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+#endif // DATAGRAMIO_H
@@ -0,0 +1,44 @@
+#ifndef INPUTREADER_H
+#define INPUTREADER_H
+
+#include <cstddef>
+#include <string_view>
+#include <sys/types.h>
+
+// Reads stdin in large chunks with read() and splits them into lines.
+// Nothing is buffered outside of this object, so poll() on the descriptor always
+// tells the truth, unlike with std::cin.
+class InputReader {
+public:
+    static constexpr size_t CAPACITY = 64 * 1024; // Longest accepted line
+
+    InputReader();
+
+    // One read() into free space, returns its result (0 at end of input).
+    // Call only when poll() reported the descriptor readable, then it doesn't block.
+    ssize_t readFrom(int fd);
+
+    // Next complete line without '\n'. After end of input the unterminated tail is returned too.
+    // The view is valid until the next readFrom().
+    bool nextLine(std::string_view& line);
+
+    // Returns the line from the last nextLine() back, it will be read again
+    void unreadLine();
+
+    bool eof() const;
+
+    // Number of lines that were too long and got dropped
+    size_t dropped() const;
+
+private:
+    char buffer[CAPACITY];
+    size_t start;       // First byte of the oldest unread line
+    size_t end;         // End of the received data
+    size_t scan;        // Bytes before this were searched for '\n'
+    size_t last_start;  // Start of the line returned by the last nextLine()
+    bool at_eof;
+    bool discarding;    // Skipping the rest of an overlong line
+    size_t overlong;
+};
+
+#endif // INPUTREADER_H
@@ -0,0 +1,42 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "OutputSink.h"
+
+// Durations in log-linear buckets of constant memory. Every power of two of nanoseconds
+// is split into 2^SUB_BITS equal buckets, so a reported percentile is at most ~3 % too high.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+    LatencyHistogram();
+
+    void record(std::chrono::steady_clock::duration duration);
+    void reset();
+
+    uint64_t count() const;
+    std::chrono::nanoseconds max() const;
+
+    // Value that `percent` % of samples don't exceed, upper edge of its bucket
+    std::chrono::nanoseconds percentile(double percent) const;
+
+    // "<name> latency (us): samples N p50 .. p99 .. p99.9 .. max .."
+    void print(OutputBuffer& out, std::string_view name) const;
+
+private:
+    std::array<uint64_t, BUCKETS> buckets;
+    uint64_t samples;
+    uint64_t maximum; // Nanoseconds
+
+    static size_t bucketOf(uint64_t value);
+    static uint64_t upperEdge(size_t bucket); // Largest value in the bucket
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,42 @@
+#ifndef LINEFRAMER_H
+#define LINEFRAMER_H
+
+#include <cstddef>
+#include <string_view>
+
+// Splits a TCP byte stream into CRLF terminated frames.
+// Bytes are received straight into a fixed ring, frames are handed out as views
+// without the terminator, partial tails stay buffered until the next read.
+class LineFramer {
+public:
+    static constexpr size_t CAPACITY = 1 << 16; // Must be a power of two
+
+    LineFramer();
+
+    // Contiguous free space where the next recv() can write
+    char* writePtr();
+    size_t writable() const;
+    void commit(size_t bytes);
+
+    // Returns the next complete frame, false if only a partial tail is left.
+    // The view is valid until the next call to any non-const method.
+    bool nextFrame(std::string_view& frame);
+
+    // Buffer is full and still contains no terminator
+    bool overflow() const;
+    size_t buffered() const;
+    void reset();
+
+private:
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    char ring[CAPACITY];
+    char linear[CAPACITY]; // Scratch for frames that wrap around the end of the ring
+    size_t head;           // Start of the oldest unconsumed byte
+    size_t tail;           // End of the received data
+    size_t scan;           // Everything before this was already searched for '\n'
+
+    size_t findNewline(size_t from) const;
+};
+
+#endif // LINEFRAMER_H
@@ -6,6 +6,65 @@
 #include <sstream>
 #include <vector>
 #include <chrono>
+#include <span>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+enum class MessageType {
+    CONFIRM,
+    ERR,
+    BYE,
+    MSG,
+    REPLY,
+    AUTH, // Sent only by clients
+    JOIN, // Sent only by clients
+    UNKNOWN
+};
+
+// Largest message the client ever builds, buffers for serialize_into() of this size never overflow
+constexpr size_t MAX_MESSAGE_SIZE = 65536;
+
+// Writes message fields into a caller-owned buffer, used by serialize_into()
+struct ByteWriter {
+    std::span<std::byte> out;
+    size_t length = 0;
+    bool overflow = false;
+
+    explicit ByteWriter(std::span<std::byte> o) : out(o) {}
+
+    void put(std::string_view text) {
+        if (overflow || text.size() > out.size() - length) {
+            overflow = true;
+            return;
+        }
+        memcpy(out.data() + length, text.data(), text.size());
+        length += text.size();
+    }
+
+    void put(std::span<const uint8_t> bytes) {
+        put(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+    }
+
+    void put(uint8_t byte) {
+        if (overflow || length == out.size()) {
+            overflow = true;
+            return;
+        }
+        out[length++] = static_cast<std::byte>(byte);
+    }
+
+    // MessageID in network byte order
+    void putId(uint16_t message_id) {
+        put(static_cast<uint8_t>(message_id >> 8));
+        put(static_cast<uint8_t>(message_id & 0xFF));
+    }
+
+    // Bytes written, 0 if the message didn't fit
+    size_t finish() const {
+        return overflow ? 0 : length;
+    }
+};
 
 // AUTH message structure
 struct AuthMessage {
@@ -46,6 +105,37 @@ struct AuthMessage {
 
         return message;
     }
+
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put("AUTH ");
+        w.put(username);
+        w.put(" AS ");
+        w.put(secret);
+        w.put(" USING ");
+        w.put(display_name);
+        w.put("\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0x02));
+        w.putId(message_id);
+        w.put(username);
+        w.put(uint8_t(0));
+        w.put(secret);
+        w.put(uint8_t(0));
+        w.put(display_name);
+        w.put(uint8_t(0));
+
+        return w.finish();
+    }
 };
 
 // JOIN message structure
@@ -82,6 +172,33 @@ struct JoinMessage {
 
         return message;
     }
+
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put("JOIN ");
+        w.put(channel_id);
+        w.put(" AS ");
+        w.put(display_name);
+        w.put("\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0x03));
+        w.putId(message_id);
+        w.put(channel_id);
+        w.put(uint8_t(0));
+        w.put(display_name);
+        w.put(uint8_t(0));
+
+        return w.finish();
+    }
 };
 
 // MSG message structure
@@ -121,6 +238,33 @@ struct MsgMessage {
         return message;
     }
 
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put("MSG FROM ");
+        w.put(display_name);
+        w.put(" IS ");
+        w.put(message_content);
+        w.put("\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0x04));
+        w.putId(message_id);
+        w.put(display_name);
+        w.put(uint8_t(0));
+        w.put(message_content);
+        w.put(uint8_t(0));
+
+        return w.finish();
+    }
+
     // Deserialize a string to a MsgMessage
     static MsgMessage deserialize(const std::string& str) {
         std::istringstream ss(str);
@@ -148,15 +292,17 @@ struct MsgMessage {
         size_t index = 1;
         
         MsgMessage msg;
+        if (data.size() < 3) return msg;
+
         msg.mid = static_cast<uint16_t>(data[index] << 8 | data[index + 1]);
         index += 2; // Move index past the message_id
 
-        while (data[index] != 0) { // Extract display_name
+        while (index < data.size() && data[index] != 0) { // Extract display_name
             msg.display_name += static_cast<char>(data[index++]);
         }
         index++; // Skip null terminator
 
-        while (data[index] != 0) { // Extract message_content
+        while (index < data.size() && data[index] != 0) { // Extract message_content
             msg.message_content += static_cast<char>(data[index++]);
         }
         // No need to skip null terminator at the end
@@ -171,6 +317,32 @@ struct ReplyMessage {
     std::string message_content;
 
     uint16_t mid;
+    uint16_t ref_mid; // UDP only, ID of the answered message
+
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put(success ? "REPLY OK IS " : "REPLY NOK IS ");
+        w.put(message_content);
+        w.put("\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0x01));
+        w.putId(message_id);
+        w.put(uint8_t(success ? 1 : 0));
+        w.putId(ref_mid);
+        w.put(message_content);
+        w.put(uint8_t(0));
+
+        return w.finish();
+    }
 
     static ReplyMessage deserialize(const std::string& str) {
         std::istringstream ss(str);
@@ -199,6 +371,8 @@ struct ReplyMessage {
         size_t index = 1;
         
         ReplyMessage msg;
+        if (data.size() < 6) return msg;
+
         msg.mid = static_cast<uint16_t>(data[index] << 8 | data[index + 1]);
         index += 2;
         
@@ -296,11 +470,53 @@ struct ErrorMessage {
         return message;
     }
 
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put("ERR FROM ");
+        w.put(display_name);
+        w.put(" IS ");
+        w.put(message_content);
+        w.put("\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0xFE));
+        w.putId(message_id);
+        w.put(display_name);
+        w.put(uint8_t(0));
+        w.put(message_content);
+        w.put(uint8_t(0));
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer, raw data is used as the content
+    size_t serialize_into(std::span<std::byte> out, std::span<const uint8_t> data, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0xFE));
+        w.putId(message_id);
+        w.put(display_name);
+        w.put(uint8_t(0));
+        w.put(data);
+
+        return w.finish();
+    }
+
     // UDP Deserialization
     static ErrorMessage deserialize(const std::vector<uint8_t>& data) {
         size_t index = 1;
         
         ErrorMessage msg;
+        if (data.size() < 3) return msg;
+
         msg.mid = static_cast<uint16_t>(data[index] << 8 | data[index + 1]);
         index += 2;
 
@@ -336,6 +552,25 @@ struct ByeMessage {
         // Since BYE messages have no content beyond the type and ID, no additional data is appended
         return message;
     }
+
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put("BYE\r\n");
+
+        return w.finish();
+    }
+
+    // Serialize for UDP into a caller-owned buffer
+    size_t serialize_into(std::span<std::byte> out, uint16_t message_id) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0xFF));
+        w.putId(message_id);
+
+        return w.finish();
+    }
 };
 
 struct ConfirmMessage {
@@ -356,9 +591,21 @@ struct ConfirmMessage {
         return message;
     }
 
+    // Serialize into a caller-owned buffer, returns written length or 0 if it doesn't fit
+    size_t serialize_into(std::span<std::byte> out) const {
+        ByteWriter w(out);
+
+        w.put(uint8_t(0x00));
+        w.putId(message_id);
+
+        return w.finish();
+    }
+
     // Deserialize a binary data array to a ConfirmMessage
     static ConfirmMessage deserialize(const std::vector<uint8_t>& data) {
-        ConfirmMessage msg;
+        ConfirmMessage msg(0);
+        if (data.size() < 3) return msg;
+
         msg.message_id = (static_cast<uint16_t>(data[1]) << 8) | static_cast<uint16_t>(data[2]);
 
         return msg;
@@ -369,14 +616,231 @@ struct UnknownMessage {
     uint16_t message_id;
     std::vector<uint8_t> payload;
     
-    explicit UnknownMessage(std::vector<uint8_t> p) : payload(p) {
-        message_id = (static_cast<uint16_t>(p[1]) << 8) | static_cast<uint16_t>(p[2]);
+    explicit UnknownMessage(std::vector<uint8_t> p) : message_id(0), payload(p) {
+        if (p.size() >= 3) message_id = (static_cast<uint16_t>(p[1]) << 8) | static_cast<uint16_t>(p[2]);
+    }
+};
+
+// Views over a received UDP datagram. They point into the receive buffer and
+// are valid only as long as it is not overwritten, nothing is copied.
+namespace udp_view {
+    // MessageID from the header, false if the datagram is shorter than the header
+    inline bool readId(std::span<const uint8_t> data, uint16_t& message_id) {
+        if (data.size() < 3) return false;
+        message_id = static_cast<uint16_t>(data[1] << 8 | data[2]);
+        return true;
+    }
+
+    // NUL terminated string starting at index, index is moved past the terminator
+    inline bool readString(std::span<const uint8_t> data, size_t& index, std::string_view& out) {
+        if (index >= data.size()) return false;
+
+        const uint8_t* start = data.data() + index;
+        const void* end = memchr(start, 0, data.size() - index);
+        if (end == nullptr) return false; // Terminator is missing
+
+        size_t length = static_cast<const uint8_t*>(end) - start;
+        out = std::string_view(reinterpret_cast<const char*>(start), length);
+        index += length + 1;
+        return true;
+    }
+}
+
+// MSG and ERR have the same layout: header, DisplayName, MessageContents
+struct MsgView {
+    uint16_t mid;
+    std::string_view display_name;
+    std::string_view message_content;
+
+    // Parses in place, false if the datagram is malformed
+    static bool parse(std::span<const uint8_t> data, MsgView& view) {
+        size_t index = 3;
+        return udp_view::readId(data, view.mid)
+            && udp_view::readString(data, index, view.display_name)
+            && udp_view::readString(data, index, view.message_content);
+    }
+};
+
+using ErrorView = MsgView;
+
+struct ReplyView {
+    uint16_t mid;
+    bool success;
+    uint16_t ref_mid; // ID of the message this REPLY answers
+    std::string_view message_content;
+
+    // Parses in place, false if the datagram is malformed
+    static bool parse(std::span<const uint8_t> data, ReplyView& view) {
+        if (data.size() < 6 || !udp_view::readId(data, view.mid)) return false;
+
+        view.success = data[3] != 0;
+        view.ref_mid = static_cast<uint16_t>(data[4] << 8 | data[5]);
+
+        size_t index = 6;
+        return udp_view::readString(data, index, view.message_content);
+    }
+};
+
+// AUTH: header, Username, DisplayName, Secret
+struct AuthView {
+    uint16_t mid;
+    std::string_view username;
+    std::string_view display_name;
+    std::string_view secret;
+
+    static bool parse(std::span<const uint8_t> data, AuthView& view) {
+        size_t index = 3;
+        return udp_view::readId(data, view.mid)
+            && udp_view::readString(data, index, view.username)
+            && udp_view::readString(data, index, view.display_name)
+            && udp_view::readString(data, index, view.secret);
+    }
+};
+
+// JOIN: header, ChannelID, DisplayName
+struct JoinView {
+    uint16_t mid;
+    std::string_view channel_id;
+    std::string_view display_name;
+
+    static bool parse(std::span<const uint8_t> data, JoinView& view) {
+        size_t index = 3;
+        return udp_view::readId(data, view.mid)
+            && udp_view::readString(data, index, view.channel_id)
+            && udp_view::readString(data, index, view.display_name);
+    }
+};
+
+struct ConfirmView {
+    uint16_t ref_mid;
+
+    static bool parse(std::span<const uint8_t> data, ConfirmView& view) {
+        return udp_view::readId(data, view.ref_mid);
+    }
+};
+
+// Scanner for the TCP text grammar, keywords are case-insensitive
+namespace text_view {
+    enum class Keyword { NONE, ERR, BYE, MSG, REPLY, FROM, IS, OK, NOK, AUTH, JOIN, AS, USING };
+
+    struct Entry {
+        std::string_view word; // Upper case
+        Keyword keyword;
+    };
+
+    inline constexpr Entry KEYWORDS[] = {
+        {"ERR", Keyword::ERR}, {"BYE", Keyword::BYE}, {"MSG", Keyword::MSG}, {"REPLY", Keyword::REPLY},
+        {"FROM", Keyword::FROM}, {"IS", Keyword::IS}, {"OK", Keyword::OK}, {"NOK", Keyword::NOK},
+        {"AUTH", Keyword::AUTH}, {"JOIN", Keyword::JOIN}, {"AS", Keyword::AS}, {"USING", Keyword::USING},
+    };
+
+    // Keywords consist of letters only, clearing bit 0x20 folds a-z to A-Z
+    inline bool equalsIgnoreCase(std::string_view token, std::string_view upper) {
+        if (token.size() != upper.size()) return false;
+        for (size_t i = 0; i < token.size(); i++) {
+            if ((token[i] & ~0x20) != upper[i]) return false;
+        }
+        return true;
+    }
+
+    inline Keyword lookup(std::string_view token) {
+        for (const Entry& entry : KEYWORDS) {
+            if (equalsIgnoreCase(token, entry.word)) return entry.keyword;
+        }
+        return Keyword::NONE;
+    }
+
+    // Splits off the token up to the next space, false if no space follows it
+    inline bool nextToken(std::string_view& rest, std::string_view& token) {
+        size_t space = rest.find(' ');
+        if (space == std::string_view::npos) {
+            token = rest;
+            rest = std::string_view();
+            return false;
+        }
+        token = rest.substr(0, space);
+        rest.remove_prefix(space + 1);
+        return true;
+    }
+}
+
+// Received TCP message, fields point into the frame
+struct TextView {
+    MessageType type = MessageType::UNKNOWN;
+    bool success = false; // REPLY only
+    std::string_view display_name;
+    std::string_view message_content;
+    std::string_view username, secret; // AUTH only
+    std::string_view channel_id;       // JOIN only
+
+    // Classifies a frame (without CRLF) and extracts its fields in one pass,
+    // malformed frames are returned as MessageType::UNKNOWN. AUTH and JOIN are
+    // recognized for the reference server, the client treats them as unknown.
+    static TextView parse(std::string_view frame) {
+        using namespace text_view;
+
+        TextView view;
+        std::string_view rest = frame, token;
+        bool more = nextToken(rest, token);
+        Keyword kind = lookup(token);
+
+        switch (kind) {
+            case Keyword::BYE:
+                if (!more) view.type = MessageType::BYE;
+                break;
+            case Keyword::MSG:
+            case Keyword::ERR:
+                // MSG|ERR FROM {DisplayName} IS {MessageContent}
+                if (more && nextToken(rest, token) && lookup(token) == Keyword::FROM
+                    && nextToken(rest, view.display_name) && !view.display_name.empty()
+                    && nextToken(rest, token) && lookup(token) == Keyword::IS) {
+                    view.message_content = rest;
+                    view.type = kind == Keyword::ERR ? MessageType::ERR : MessageType::MSG;
+                }
+                break;
+            case Keyword::REPLY:
+                // REPLY OK|NOK IS {MessageContent}
+                if (more && nextToken(rest, token)) {
+                    Keyword result = lookup(token);
+                    view.success = result == Keyword::OK;
+                    if ((result == Keyword::OK || result == Keyword::NOK)
+                        && nextToken(rest, token) && lookup(token) == Keyword::IS) {
+                        view.message_content = rest;
+                        view.type = MessageType::REPLY;
+                    }
+                }
+                break;
+            case Keyword::AUTH:
+                // AUTH {Username} AS {DisplayName} USING {Secret}
+                if (more && nextToken(rest, view.username) && !view.username.empty()
+                    && nextToken(rest, token) && lookup(token) == Keyword::AS
+                    && nextToken(rest, view.display_name) && !view.display_name.empty()
+                    && nextToken(rest, token) && lookup(token) == Keyword::USING
+                    && !nextToken(rest, view.secret) && !view.secret.empty()) {
+                    view.type = MessageType::AUTH;
+                }
+                break;
+            case Keyword::JOIN:
+                // JOIN {ChannelID} AS {DisplayName}
+                if (more && nextToken(rest, view.channel_id) && !view.channel_id.empty()
+                    && nextToken(rest, token) && lookup(token) == Keyword::AS
+                    && !nextToken(rest, view.display_name) && !view.display_name.empty()) {
+                    view.type = MessageType::JOIN;
+                }
+                break;
+            default:
+                break;
+        }
+
+        return view;
     }
 };
 
 struct TimedMessage {
     std::vector<uint8_t> message_data; // Message data
+    std::chrono::steady_clock::time_point first_send_time; // Time of the first transmission
     std::chrono::steady_clock::time_point send_time; // Time when the message was last sent
+    std::chrono::steady_clock::time_point deadline; // Time when the message is retransmitted if not confirmed
     int retry_count = 0; // Number of times the message has been retried
 };
 
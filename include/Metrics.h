@@ -0,0 +1,72 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Counters and gauges of one session. Writers update them with relaxed atomics on the
+// hot paths, which costs about as much as a plain increment, and readers (the /stats
+// command or a SIGUSR1 handler) take a snapshot whenever they want.
+class Metrics {
+public:
+    static constexpr size_t LINE_SIZE = 1024; // Enough for every metric
+
+    class Counter {
+    public:
+        void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value{0};
+    };
+
+    class Gauge {
+    public:
+        void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+        void add(int64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> value{0};
+    };
+
+    Metrics();
+
+    // Protocol messages, CONFIRMs counted separately
+    Counter messages_sent, messages_received;
+    Counter confirms_sent, confirms_received;
+    Counter bytes_sent, bytes_received; // TCP stream or UDP datagrams
+    Counter retransmissions;     // Messages sent again by checkForTimeouts()
+    Counter messages_confirmed;  // Sent messages whose CONFIRM arrived, duplicates excluded
+    Counter confirm_timeouts;    // Messages given up after the last retry
+    Counter send_errors;         // Messages the socket refused
+    Counter replies_refused;     // Negative REPLYs
+    Counter unknown_messages;    // Unknown or malformed messages, answered by ERR
+    Counter duplicates;          // UDP messages received again
+    Counter unexpected_confirms; // CONFIRMs of no message in flight
+    Counter reconnects;          // Sessions recovered after a lost connection
+
+    Gauge command_queue;            // Commands waiting for the server
+    Gauge command_queue_high_water;
+    Gauge window_in_flight;         // Unconfirmed UDP messages
+    Gauge rto_us, srtt_us;
+    Gauge udp_recv_calls, udp_recv_datagrams; // recvmmsg()/io_uring batches, average depth is datagrams/calls
+    Gauge udp_send_calls, udp_send_datagrams;
+    Gauge auth_wait_us;             // Time between sending AUTH and its REPLY, all attempts together
+    Gauge recovery_us;              // Last lost connection -> replayed AUTH answered
+    Gauge transcript_written, transcript_dropped; // Records of the transcript (-T)
+
+    // One line of space separated key=value pairs, returns its length.
+    // Doesn't allocate or lock, so it may be called from a signal handler.
+    size_t format(char* out, size_t size) const;
+
+    // Writes the line to fd with write(), async-signal-safe
+    void dump(int fd) const;
+
+private:
+    std::chrono::steady_clock::time_point started;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,64 @@
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <string_view>
+#include <vector>
+
+// Text waiting to be written to one file descriptor
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd);
+
+    OutputBuffer& operator<<(std::string_view text);
+    OutputBuffer& operator<<(const char* text);
+    OutputBuffer& operator<<(char c);
+    OutputBuffer& operator<<(bool value); // As 0/1, same as iostreams
+
+    template<std::integral T>
+    OutputBuffer& operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        return *this << std::string_view(digits, result.ptr - digits);
+    }
+
+    OutputBuffer& operator<<(double value);
+
+    size_t size() const;
+    bool write(); // Writes everything buffered, false on error
+
+private:
+    friend class OutputSink;
+
+    int fd; // -1 when muted
+    OutputBuffer* other; // The other stream of the sink, written first when output switches to this one
+    std::vector<char> data;
+    std::chrono::steady_clock::time_point oldest; // When the first unwritten byte was added
+};
+
+// Buffered stdout and stderr. Text is formatted into memory and written once per
+// event loop iteration, earlier only when too much of it piles up or it is waiting too long.
+// Lines come out in the order they were produced: when text goes to one stream while the
+// other one holds some, the other one is written first.
+class OutputSink {
+public:
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+    static constexpr std::chrono::milliseconds FLUSH_DELAY{10};
+
+    OutputSink();
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete; // The buffers point at each other
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    OutputBuffer out; // stdout
+    OutputBuffer err; // stderr
+
+    void flush();
+    void flushIfDue(); // Flushes if the size threshold or the deadline was reached
+    void mute();       // Everything written from now on is dropped
+};
+
+#endif // OUTPUTSINK_H
@@ -0,0 +1,80 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+
+class Reactor;
+
+// Something that owns descriptors registered in a Reactor
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+
+    // One of the handler's descriptors is ready
+    virtual void onEvent(int fd, uint32_t events) = 0;
+
+    // Called once per reactor iteration after all events of the iteration were dispatched,
+    // only for handlers that got an event or asked for it by Reactor::schedule()
+    virtual void afterEvents() {}
+
+private:
+    friend class Reactor;
+    bool pending = false;
+};
+
+// Single-threaded epoll event loop, multiplexes any number of sessions
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    bool valid() const;
+
+    // Level-triggered registration of fd for given epoll events
+    bool add(int fd, uint32_t events, EventHandler* handler);
+    bool modify(int fd, uint32_t events); // Changes the events fd is watched for
+    void remove(int fd);
+
+    // Handler stays alive in run() until it is detached
+    void attach(EventHandler* handler);
+    void detach(EventHandler* handler);
+
+    // afterEvents() will be called in the next iteration, which won't block
+    void schedule(EventHandler* handler);
+
+    // afterEvents() will be called once deadline passed, max() cancels it. For handlers
+    // without a timerfd, epoll_wait() then sleeps only until the earliest deadline.
+    void wakeAt(EventHandler* handler, std::chrono::steady_clock::time_point deadline);
+
+    // Dispatches events until every handler detached or stop() was called.
+    // Returns false if epoll failed.
+    bool run();
+
+    // Safe to call from a signal handler, wakes up a blocked run()
+    void stop();
+
+private:
+    int epoll_fd;
+    int stop_fd; // eventfd in the epoll set, written by stop() so a stop just before epoll_wait() isn't missed
+    size_t attached;
+    std::atomic<bool> stopping;
+
+    std::vector<EventHandler*> handlers; // Indexed by descriptor
+    std::vector<EventHandler*> ready;    // Waiting for afterEvents()
+    std::vector<EventHandler*> dispatching;
+    std::vector<struct epoll_event> events;
+    std::vector<std::pair<EventHandler*, std::chrono::steady_clock::time_point>> wakeups; // Set by wakeAt()
+
+    void markReady(EventHandler* handler);
+    int waitMs() const; // epoll_wait() timeout
+    void wakeDue(); // Handlers whose wakeAt() deadline passed are made ready
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,36 @@
+#ifndef RTTESTIMATOR_H
+#define RTTESTIMATOR_H
+
+#include <chrono>
+#include <random>
+
+// Smoothed round-trip time and retransmission timeout of a UDP session (RFC 6298).
+// Samples are taken from CONFIRM arrival times, retries back off exponentially with jitter.
+class RttEstimator {
+public:
+    using Duration = std::chrono::microseconds;
+
+    static constexpr Duration MIN_RTO = std::chrono::milliseconds(10);
+    static constexpr Duration MAX_RTO = std::chrono::seconds(60);
+
+    // Initial RTO is used until the first sample arrives
+    explicit RttEstimator(std::chrono::milliseconds initial);
+
+    // Round-trip time of a message that was sent only once (Karn's rule is on the caller)
+    void sample(std::chrono::steady_clock::duration rtt);
+
+    // Timeout for given attempt, rto * 2^retry_count plus up to 25 % jitter on retries
+    Duration timeout(int retry_count);
+
+    Duration rto() const;
+    Duration srtt() const;
+    Duration rttvar() const;
+    bool hasSample() const;
+
+private:
+    Duration smoothed, variation, current;
+    bool measured;
+    std::minstd_rand jitter;
+};
+
+#endif // RTTESTIMATOR_H
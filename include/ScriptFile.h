@@ -0,0 +1,40 @@
+#ifndef SCRIPTFILE_H
+#define SCRIPTFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Input script (-f) mapped into memory. Lines are handed out as views into the
+// mapping, so nothing is read() or copied, however large the script is.
+class ScriptFile {
+public:
+    ScriptFile();
+    ~ScriptFile();
+
+    ScriptFile(const ScriptFile&) = delete;
+    ScriptFile& operator=(const ScriptFile&) = delete;
+
+    // Maps the whole file, false with errno set if it can't be opened or mapped
+    bool open(const std::string& path);
+
+    // Next line without '\n', the last one may be unterminated.
+    // The view is valid as long as the object.
+    bool nextLine(std::string_view& line);
+
+    // Returns the line from the last nextLine() back, it will be taken again
+    void unreadLine();
+
+    bool eof() const; // Every line was taken
+    size_t lines() const; // Taken so far
+    size_t size() const;
+
+private:
+    const char* data;
+    size_t length;
+    size_t position;      // Start of the next line
+    size_t last_position; // Start of the line returned by the last nextLine()
+    size_t taken;
+};
+
+#endif // SCRIPTFILE_H
@@ -0,0 +1,30 @@
+#ifndef SEENIDS_H
+#define SEENIDS_H
+
+#include <cstdint>
+
+// Remembers MessageIDs received from the server to drop retransmitted duplicates.
+// One bit per ID, only the newest half of the 16-bit ID space is remembered,
+// so IDs that wrap around are treated as new again.
+class SeenIds {
+public:
+    SeenIds();
+
+    // Marks the ID as seen, false if it was seen already
+    bool insert(uint16_t message_id);
+    void clear();
+
+private:
+    static constexpr uint32_t ID_SPACE = 1 << 16;
+    static constexpr uint16_t HALF = ID_SPACE / 2;
+
+    uint64_t bits[ID_SPACE / 64];
+    uint16_t newest; // Highest ID seen so far, modulo 2^16
+    bool started;
+
+    bool test(uint16_t id) const;
+    void set(uint16_t id);
+    void forget(uint16_t from, uint16_t count);
+};
+
+#endif // SEENIDS_H
@@ -0,0 +1,57 @@
+#ifndef SENDWINDOW_H
+#define SENDWINDOW_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Messages.h"
+
+// Keeps track of UDP messages that were sent but not confirmed yet.
+// Up to `size` messages with consecutive IDs may be in flight, confirms may arrive in any order.
+// IDs are compared modulo 2^16, so the window keeps working after MessageID wraps around.
+class SendWindow {
+public:
+    static constexpr uint16_t MAX_SIZE = 0x8000; // Half of the ID space, keeps ID distances unambiguous
+
+    explicit SendWindow(uint16_t size);
+
+    uint16_t size() const;
+    size_t inFlight() const;
+    bool empty() const;
+    bool full() const;
+
+    // Starts tracking a freshly sent message, false if the window is full
+    bool push(uint16_t message_id, std::span<const std::byte> data, std::chrono::steady_clock::time_point now,
+              std::chrono::steady_clock::time_point deadline);
+
+    // Stops tracking a message, false if the ID is not in flight (duplicate or unexpected CONFIRM)
+    bool confirm(uint16_t message_id);
+
+    // Unconfirmed message with given ID, nullptr if it is not in flight
+    TimedMessage* find(uint16_t message_id);
+
+    // Calls f(message_id, TimedMessage&) for every unconfirmed message, oldest first
+    template<typename F>
+    void forEach(F f) {
+        for (uint16_t id = base; id != next; id++) {
+            Slot& slot = slots[id & mask];
+            if (slot.used) f(id, slot.message);
+        }
+    }
+
+private:
+    struct Slot {
+        bool used = false;
+        TimedMessage message;
+    };
+
+    std::vector<Slot> slots; // Power of two sized, indexed by message_id & mask
+    uint16_t mask;
+    uint16_t window;
+    uint16_t base;           // Oldest unconfirmed ID
+    uint16_t next;           // ID following the newest tracked one
+    size_t in_flight;
+};
+
+#endif // SENDWINDOW_H
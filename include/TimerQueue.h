@@ -0,0 +1,31 @@
+#ifndef TIMERQUEUE_H
+#define TIMERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <chrono>
+
+// Min-heap of retransmission deadlines keyed by MessageID.
+// Entries are never removed on CONFIRM, the owner drops stale ones when they reach the top.
+class TimerQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point deadline;
+        uint16_t message_id;
+    };
+
+    void schedule(Clock::time_point deadline, uint16_t message_id);
+
+    bool empty() const;
+    size_t size() const;
+    const Timer& top() const;
+    void pop();
+    void clear();
+
+private:
+    std::vector<Timer> heap;
+};
+
+#endif // TIMERQUEUE_H
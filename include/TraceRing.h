@@ -0,0 +1,89 @@
+#ifndef TRACERING_H
+#define TRACERING_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TraceEvent : uint8_t {
+    SEND,       // value: bytes
+    RECV,       // value: bytes
+    CONFIRM,    // id: confirmed MessageID, value: microseconds since its first send, UNEXPECTED if not in flight
+    RETRANSMIT, // value: retry number
+    GIVE_UP,    // Last retry expired, value: retries
+    STATE,      // value: TraceState bits
+    DEQUEUE,    // Queued command taken, type: CommandType, value: commands left
+    RECONNECT,  // type: 1 if connected, value: attempt number
+};
+
+// Bits of the STATE event
+namespace trace_state {
+    constexpr uint32_t WAITING_FOR_AUTH = 1;
+    constexpr uint32_t WAITING_FOR_RESPONSE = 2;
+    constexpr uint32_t WINDOW_FULL = 4;
+    constexpr uint32_t INPUT_BLOCKED = 8;
+    constexpr uint32_t BYE = 16;
+    constexpr uint32_t ERR = 32;
+    constexpr uint32_t DONE = 64;
+    constexpr uint32_t RECONNECTING = 128; // Connection lost or AUTH not replayed yet
+}
+
+// Messages of both variants are traced with the type codes of the UDP variant
+constexpr uint8_t TRACE_UNKNOWN_TYPE = 0x80;
+constexpr uint32_t TRACE_UNEXPECTED = UINT32_MAX;
+
+struct TraceRecord {
+    uint64_t time;  // steady_clock in nanoseconds
+    uint8_t event;  // TraceEvent
+    uint8_t type;   // Message type code, or CommandType for DEQUEUE
+    uint16_t id;    // MessageID, 0 in the TCP variant
+    uint32_t value; // Depends on the event
+};
+static_assert(sizeof(TraceRecord) == 16);
+
+// File starts with this header, records follow oldest first
+struct TraceHeader {
+    char magic[8];        // "IPKTRACE"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t records;     // Records in the file
+    uint64_t recorded;    // All events of the session, the oldest ones were overwritten
+};
+
+// Last CAPACITY protocol events of a session. Always on: recording an event is one
+// clock read and a 16 byte store into a fixed array, nothing is formatted or allocated.
+class TraceRing {
+public:
+    static constexpr size_t CAPACITY = 2048; // Power of two
+    static constexpr char MAGIC[8] = {'I', 'P', 'K', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr uint32_t VERSION = 1;
+
+    TraceRing();
+
+    void record(TraceEvent event, uint8_t type, uint16_t id, uint32_t value) {
+        TraceRecord& r = ring[next & (CAPACITY - 1)];
+        r.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        r.event = static_cast<uint8_t>(event);
+        r.type = type;
+        r.id = id;
+        r.value = value;
+        next++;
+    }
+
+    uint64_t recorded() const;
+
+    // Writes the header and the records to path, false with errno set on failure
+    bool dump(const std::string& path) const;
+
+    // Reads a dumped trace, false if it can't be read or is not a trace
+    static bool load(const std::string& path, TraceHeader& header, std::vector<TraceRecord>& records);
+
+private:
+    std::array<TraceRecord, CAPACITY> ring;
+    uint64_t next;
+};
+
+#endif // TRACERING_H
@@ -0,0 +1,99 @@
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// When the transcript is forced to disk
+enum class TranscriptSync : uint8_t {
+    NONE,   // Left to the kernel
+    ROTATE, // fdatasync() when a file is rotated or closed
+    BATCH,  // fdatasync() after every written batch
+};
+
+// One sent or received message. Fixed size, so the ring is a plain array.
+struct TranscriptRecord {
+    static constexpr size_t NAME_SIZE = 32;
+    static constexpr size_t TEXT_SIZE = 1488; // Longest protocol content is 1400
+
+    int64_t time;         // Wall clock in nanoseconds since the epoch
+    uint8_t received;     // 1 received, 0 sent
+    uint8_t type;         // Message type code of the UDP variant
+    uint8_t truncated;    // Name or text didn't fit
+    uint8_t name_length;
+    uint16_t text_length;
+    char name[NAME_SIZE];
+    char text[TEXT_SIZE];
+};
+static_assert(sizeof(TranscriptRecord) == 1536);
+
+// Append-only log of every message of a session (-T). The network loop only copies a
+// record into a single-producer single-consumer ring, a writer thread formats what
+// has accumulated and appends it to the file with one write(). When the disk can't
+// keep up and the ring is full, records are dropped and counted instead of blocking.
+// An idle writer sleeps on an eventfd, which push() signals only when it was asleep, and a
+// busy one naps 1 ms between batches, so neither side makes a system call per record.
+class Transcript {
+public:
+    static constexpr size_t CAPACITY = 4096; // Records in the ring (6 MiB), power of two
+    static constexpr size_t BATCH_SIZE = 1024 * 1024; // Formatted bytes per write()
+    static constexpr size_t PREALLOCATE = 16 * 1024 * 1024; // File space reserved ahead of the writes
+
+    // rotate_size 0 never rotates, otherwise the file is renamed to <path>.<n> once it gets larger
+    Transcript(std::string path, uint64_t rotate_size, TranscriptSync sync);
+    ~Transcript(); // Stops the writer
+
+    // Opens the file and starts the writer, false with errno set if the file can't be opened
+    bool start();
+
+    // Writes out what is left in the ring and joins the writer
+    void stop();
+
+    // Network thread only. Never blocks or allocates, false if the record was dropped.
+    bool push(bool received, uint8_t type, std::string_view name, std::string_view text);
+
+    uint64_t written() const;
+    uint64_t dropped() const;
+    uint64_t batches() const;
+    int error() const; // errno of the first failed write, 0 if none
+
+    static bool parseSync(std::string_view name, TranscriptSync& sync);
+
+private:
+    std::string path;
+    uint64_t rotate_size;
+    TranscriptSync sync;
+
+    std::unique_ptr<std::array<TranscriptRecord, CAPACITY>> ring;
+    alignas(64) std::atomic<uint64_t> head; // Next record to fill, written by push()
+    alignas(64) std::atomic<uint64_t> tail; // Next record to write, written by the writer
+    alignas(64) std::atomic<uint64_t> dropped_records;
+    std::atomic<uint64_t> written_records, written_batches;
+    std::atomic<int> write_error;
+    std::atomic<bool> stopping;
+    std::atomic<bool> sleeping; // Writer found the ring empty and waits on wake_fd
+    int wake_fd;                // eventfd
+
+    // Writer thread only
+    std::thread writer;
+    std::unique_ptr<char[]> batch;
+    int fd;
+    uint64_t file_size, allocated; // Bytes in the file, and reserved by fallocate()
+    unsigned rotations;
+
+    void run();
+    size_t drain(); // Formats and writes everything in the ring, returns records written
+    void flushBatch(size_t length, size_t records); // Writes the formatted batch and counts its records
+    bool append(const char* data, size_t length);
+    bool openFile();
+    void closeFile(); // Gives back the space reserved past the end
+    bool rotate();
+};
+
+#endif // TRANSCRIPT_H
@@ -0,0 +1,115 @@
+#ifndef URINGDATAGRAMIO_H
+#define URINGDATAGRAMIO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+#include "DatagramIO.h"
+
+// UDP I/O over io_uring. One multishot recvmsg stays armed and fills buffers of a
+// registered buffer ring, completions are reaped from shared memory without a system call.
+// Queued datagrams are submitted as sendmsg requests by one io_uring_enter() per flush.
+class UringDatagramIO : public DatagramIO {
+public:
+    static constexpr size_t BUFFER_SIZE = 4096;     // Header, sender address and payload of one datagram
+    static constexpr size_t SEND_ARENA_SIZE = 65536;
+
+    explicit UringDatagramIO(size_t batch_size);
+    ~UringDatagramIO() override;
+    UringDatagramIO(const UringDatagramIO&) = delete;
+    UringDatagramIO& operator=(const UringDatagramIO&) = delete;
+
+    // False when the kernel lacks io_uring, provided buffer rings or the needed operations
+    bool valid() const;
+
+    // Arms the multishot receive, false if the kernel refused it
+    bool start(int fd) override;
+    int pollFd() const override; // Ring descriptor, readable when completions wait
+
+    int receive(int fd) override;
+    std::span<const uint8_t> datagram(int index) const override;
+    const struct sockaddr_storage& sender(int index) const override;
+    bool truncated(int index) const override;
+
+    bool queue(std::span<const std::byte> data) override;
+    bool pending() const override;
+    bool flush(int fd, const struct sockaddr_storage& dest) override;
+
+    const Stats& stats() const override;
+    const char* name() const override;
+
+private:
+    struct Received {
+        uint16_t buffer_id;
+        const uint8_t* payload;
+        size_t length;
+        struct sockaddr_storage addr;
+        bool truncated;
+    };
+
+    // Sends of one flush stay in flight until their completions are reaped,
+    // a new outbox is taken for the next flush meanwhile
+    struct Outbox {
+        std::vector<std::byte> data;
+        size_t used = 0;
+        std::vector<struct iovec> iov;
+        std::vector<struct msghdr> msgs;
+        size_t count = 0;
+        size_t in_flight = 0;
+        struct sockaddr_storage dest = {};
+    };
+
+    size_t batch_size;
+    int ring_fd;
+    int socket_fd;
+    bool armed; // Multishot receive is active
+
+    // Submission and completion queues shared with the kernel
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned sq_entries;
+    unsigned sq_pending; // Prepared, not yet submitted
+
+    // Provided buffer ring the receives pick their buffers from
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    unsigned buffer_count;
+    uint16_t buf_tail;
+    std::vector<uint8_t> buffers;
+    struct msghdr recv_msg; // Only lengths of the address and control data are used
+
+    std::vector<Received> delivered; // Reaped receive completions
+    size_t handed_out; // Leading part of delivered returned by the last receive()
+    int recv_error;
+
+    std::vector<std::unique_ptr<Outbox>> outboxes;
+    std::vector<Outbox*> free_outboxes;
+    Outbox* filling;
+    size_t sends_in_flight;
+    int send_error; // errno of a failed send completion, returned by the next flush()
+
+    Stats counters;
+
+    bool setup();
+    struct io_uring_sqe* nextSqe();
+    bool submit(unsigned wait_for);
+    void arm();
+    void reap();
+    void recycle(uint16_t buffer_id);
+    Outbox* takeOutbox();
+};
+
+#endif // URINGDATAGRAMIO_H
@@ -1,12 +1,11 @@
 #ifndef VALIDATIONHELPERS_H
 #define VALIDATIONHELPERS_H
 
-#include <string>
-#include <regex>
+#include <string_view>
 
-bool isValidId(const std::string& id);
-bool isValidSecret(const std::string& secret);
-bool isValidDName(const std::string& dname);
-bool isValidContent(const std::string& content);
+bool isValidId(std::string_view id);
+bool isValidSecret(std::string_view secret);
+bool isValidDName(std::string_view dname);
+bool isValidContent(std::string_view content);
 
-#endif // VALIDATIONHELPERS_H
\ No newline at end of file
+#endif // VALIDATIONHELPERS_H
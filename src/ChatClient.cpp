@@ -3,8 +3,9 @@
 #include <iostream>
 #include <cstring>
 #include <string>
-#include <poll.h>
+#include <sys/timerfd.h>
 #include <queue>
+#include <algorithm>
 #include <iomanip>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -13,21 +14,84 @@
 #include "ChatClient.h"
 #include "ValidationHelpers.h"
 
-ChatClient::ChatClient(const AppConfig& config)
-: config(config), server_socket(-1), mid(0),
-  waiting_for_response(false), waiting_for_confirm(false), bye(false), err(false),
+namespace {
+    // Type code of the UDP variant for a message of either variant, messages are traced with these
+    uint8_t traceType(MessageType type) {
+        switch (type) {
+            case MessageType::CONFIRM: return 0x00;
+            case MessageType::REPLY:   return 0x01;
+            case MessageType::AUTH:    return 0x02;
+            case MessageType::JOIN:    return 0x03;
+            case MessageType::MSG:     return 0x04;
+            case MessageType::ERR:     return 0xFE;
+            case MessageType::BYE:     return 0xFF;
+            default:                   return TRACE_UNKNOWN_TYPE;
+        }
+    }
+
+    // Outgoing TCP messages are classified by their first keyword
+    uint8_t traceType(std::string_view text) {
+        switch (text_view::lookup(text.substr(0, text.find_first_of(" \r")))) {
+            case text_view::Keyword::AUTH: return traceType(MessageType::AUTH);
+            case text_view::Keyword::JOIN: return traceType(MessageType::JOIN);
+            case text_view::Keyword::MSG:  return traceType(MessageType::MSG);
+            case text_view::Keyword::ERR:  return traceType(MessageType::ERR);
+            case text_view::Keyword::BYE:  return traceType(MessageType::BYE);
+            default:                       return TRACE_UNKNOWN_TYPE;
+        }
+    }
+
+    // Wait after end of input, see ChatClient::drain_timeout
+    std::chrono::milliseconds drainTimeout(const AppConfig& config) {
+        std::chrono::milliseconds wait(config.connect_timeout);
+        if (config.transport_protocol == "tcp") return wait;
+
+        // -d doubled by every retry, as RttEstimator does before it measured anything
+        auto max_rto = std::chrono::duration_cast<std::chrono::milliseconds>(RttEstimator::MAX_RTO);
+        std::chrono::milliseconds retransmissions(0), timeout = std::min<std::chrono::milliseconds>(std::chrono::milliseconds(config.timeout), max_rto);
+        for (int retry = 0; retry <= config.retransmissions_number; retry++) {
+            retransmissions += timeout;
+            timeout = std::min(timeout * 2, max_rto);
+        }
+        return std::max(wait, retransmissions);
+    }
+}
+
+ChatClient::ChatClient(const AppConfig& config, SessionObserver* observer)
+: config(config), observer(observer), server_socket(-1), mid(0),
+  waiting_for_response(false), bye(false), err(false),
   tcp(config.transport_protocol == "tcp"), connect_err(false), waiting_for_auth(true),
-  their_addr(nullptr), TIMEOUT(std::chrono::milliseconds(config.timeout)),
-  MAX_RETRIES(config.retransmissions_number)  
+  their_addr{}, candidate(0), server_answered(false), rtt(std::chrono::milliseconds(config.timeout)),
+  MAX_RETRIES(config.retransmissions_number), window(config.window_size),
+  timer_fd(-1), armed_deadline(std::chrono::steady_clock::time_point::max()),
+  reactor(nullptr), io_fd(-1), input_fd(-1), input_pollable(true), input_watched(false), input_blocked(false),
+  input_dropped(0), drain_timeout(drainTimeout(config)), drain_deadline(std::chrono::steady_clock::time_point::max()),
+  done(false), exit_status(EXIT_SUCCESS), interrupted(false), traced_state(0),
+  lost(false), recovering(false), replay_auth(false), reconnect_attempts(0), jitter(getpid()),
+  script_interval(config.script_rate ? std::chrono::nanoseconds(1000000000 / config.script_rate) : std::chrono::nanoseconds(0))
   {
-        their_addr = new struct sockaddr_in;
-        memset(their_addr, 0, sizeof(struct sockaddr_in));
+        // steady_clock is CLOCK_MONOTONIC, so deadlines can be passed to the timer directly
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd == -1) terminal.err << "ERR: timerfd_create: " << strerror(errno) << '\n';
+
+        if (config.latency) latency = std::make_unique<Latency>();
+
+        if (!config.transcript_path.empty()) {
+            TranscriptSync sync = TranscriptSync::ROTATE;
+            Transcript::parseSync(config.transcript_fsync, sync);
+            transcript = std::make_unique<Transcript>(config.transcript_path, uint64_t(config.transcript_rotate) << 20, sync);
+            if (!transcript->start()) {
+                terminal.err << "ERR: Cannot open transcript " << config.transcript_path << ": " << strerror(errno) << '\n';
+                transcript.reset();
+            }
+        }
   }
 
 ChatClient::~ChatClient() {
+    if (reactor != nullptr) detach();
     if (!connect_err) closeConnection();
 
-    delete their_addr;
+    if (timer_fd != -1) close(timer_fd);
 
     if (server_socket != -1) {
         close(server_socket);
@@ -35,24 +99,7 @@ ChatClient::~ChatClient() {
     }
 }
 
-MessageType ChatClient::determineMessageType(const std::string& message) {
-    std::istringstream ss(message);
-    std::string command;
-    ss >> command; // Extracts the first word from the message
-    
-    if (command == "ERR") {
-        return MessageType::ERR;
-    } else if (command == "BYE") {
-        return MessageType::BYE;
-    } else if (command == "MSG") {
-        return MessageType::MSG;
-    } else if (command == "REPLY") {
-        return MessageType::REPLY;
-    }
-    return MessageType::UNKNOWN;
-}
-
-MessageType ChatClient::determineMessageType(const std::vector<uint8_t>& message) {
+MessageType ChatClient::determineMessageType(std::span<const uint8_t> message) {
     if (message.empty()) return MessageType::UNKNOWN;
 
     switch (message[0]) {
@@ -66,331 +113,788 @@ MessageType ChatClient::determineMessageType(const std::vector<uint8_t>& message
 }
 
 bool ChatClient::connectToServer() {
+    // Both families are looked up in parallel, startup waits only for the fastest usable address
+    Connector connector(config.server_address, config.port, std::chrono::milliseconds(config.connect_timeout));
+
     if (!tcp) {
-        struct hostent * he;
         int broadcast = 1;
 
-        if ((he=gethostbyname(config.server_address.c_str())) == NULL) {  // get the host info
-            std::cerr << "ERR: gethostbyname" << std::endl;
+        candidates = connector.resolve();
+        if (candidates.empty()) {
+            terminal.err << "ERR: " << connector.error() << '\n';
             connect_err = true;
             return false;
         }
 
-        if ((server_socket = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
-            std::cerr << "ERR: socket" << std::endl;
+        bool ipv6 = std::any_of(candidates.begin(), candidates.end(), [](const Endpoint& e) { return e.addr.ss_family == AF_INET6; });
+        bool ipv4 = std::any_of(candidates.begin(), candidates.end(), [](const Endpoint& e) { return e.addr.ss_family == AF_INET; });
+
+        // One dual-stack socket reaches addresses of both families, IPv4 ones are mapped into IPv6
+        int v6only = 0;
+        if (ipv6 && (server_socket = socket(AF_INET6, SOCK_DGRAM, 0)) != -1 && ipv4
+            && setsockopt(server_socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof v6only) == -1) {
+            close(server_socket);
+            server_socket = -1;
+        }
+
+        if (ipv6 && server_socket != -1) {
+            for (Endpoint& endpoint : candidates) endpoint = Connector::mapped(endpoint);
+        } else if (ipv4) {
+            // No IPv6 on this host, only IPv4 addresses are left
+            std::erase_if(candidates, [](const Endpoint& e) { return e.addr.ss_family != AF_INET; });
+            server_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        }
+
+        if (server_socket == -1) {
+            terminal.err << "ERR: socket" << '\n';
             connect_err = true;
             return false;
         }
 
         // this call is what allows broadcast packets to be sent:
         if (setsockopt(server_socket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof broadcast) == -1) {
-            std::cerr << "ERR: setsockopt (SO_BROADCAST)" << std::endl;
+            terminal.err << "ERR: setsockopt (SO_BROADCAST)" << '\n';
             connect_err = true;
             return false;
         }
 
 
-        their_addr->sin_family = AF_INET;     // host byte order
-        their_addr->sin_port = htons(config.port); // short, network byte order
-        their_addr->sin_addr = *((struct in_addr *)he->h_addr);
-        memset(their_addr->sin_zero, '\0', sizeof their_addr->sin_zero);
+        udp_io = DatagramIO::create(config.io_backend, config.batch_size, server_socket);
+        if (!udp_io) {
+            terminal.err << "ERR: io_uring is not supported by the kernel (" << strerror(errno) << "), falling back to recvmmsg/sendmmsg" << '\n';
+            udp_io = DatagramIO::create("batch", config.batch_size, server_socket);
+        }
 
-        return true;
-    } else {
-        struct addrinfo hints = {0}, *addrs, *addr;
+        candidate = 0;
+        their_addr = candidates[candidate].addr;
 
-        int status;
+        // ICMP errors of unconnected sockets are reported only with RECVERR, a refused address is left at once
+        int recverr = 1;
+        if (candidates.size() > 1) {
+            setsockopt(server_socket, IPPROTO_IP, IP_RECVERR, &recverr, sizeof recverr); // Also IPv4 of a dual-stack socket
+            if (their_addr.ss_family == AF_INET6) setsockopt(server_socket, IPPROTO_IPV6, IPV6_RECVERR, &recverr, sizeof recverr);
+        }
 
-        hints.ai_family = AF_INET;
-        hints.ai_socktype = tcp ? SOCK_STREAM : SOCK_DGRAM;
-        
-        if ((status = getaddrinfo(config.server_address.c_str(), std::to_string(this->config.port).c_str(), &hints, &addrs)) != 0) {
-            std::cerr << "ERR: getaddrinfo: " << gai_strerror(status) << std::endl;
+        return true;
+    } else {
+        // Attempts to all addresses overlap, the first accepted connection is kept
+        if ((server_socket = connector.connect()) == -1) {
+            terminal.err << "ERR: client: failed to connect: " << connector.error() << '\n';
             connect_err = true;
             return false;
         }
-        
-        for (addr = addrs; addr != nullptr; addr = addr->ai_next)
-        {
-            if ((server_socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) == -1)
-            {
-                std::cerr << "ERR: client: socket" << std::endl;
-                continue;
-            }
 
-            if (tcp && connect(server_socket, addr->ai_addr, addr->ai_addrlen) == -1)
-            {
-                close(server_socket);
-                std::cerr << "ERR: client: connect" << std::endl;
-                continue;
-            }
+        return true;
+    }
+}
 
-            break;
-        }
+bool ChatClient::nextCandidate() {
+    if (server_answered || candidates.size() < 2) return false;
 
-        if (addr == nullptr) {
-            fprintf(stderr, "ERR: client: failed to connect\n");
-            freeaddrinfo(addrs);
-            return false;
-        }
+    candidate = (candidate + 1) % candidates.size();
+    their_addr = candidates[candidate].addr;
+    return true;
+}
+
+void ChatClient::candidateRefused() {
+    // Queued ICMP errors would keep the socket readable
+    struct msghdr msg = {};
+    while (recvmsg(server_socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0) {}
+
+    // After the server answered, lost datagrams are left to retransmissions
+    std::string refused = addressString(their_addr);
+    if (!nextCandidate()) return;
 
-        freeaddrinfo(addrs);
+    terminal.err << "ERR: " << refused << " refused, trying " << addressString(their_addr) << '\n';
+    window.forEach([this](uint16_t, TimedMessage& pending) {
+        sendDatagram(std::as_bytes(std::span(pending.message_data)));
+    });
+    flushOutbox();
+}
+
+bool ChatClient::sendMessage(std::span<const std::byte> message) {
+    if (latency) latency->last_sent = std::chrono::steady_clock::now();
 
+    // Counted and traced only once sent, a full window or a socket error is not a sent message
+    if (!tcp) {
+        uint16_t id = mid;
+        if (!sendTracked(message)) return false;
+        metrics.messages_sent.add();
+        trace.record(TraceEvent::SEND, uint8_t(message[0]), id, message.size());
         return true;
     }
-}
 
-bool ChatClient::sendMessage(const std::string& message) {
     ssize_t len = message.size(), sent = 0;
 
     while (sent < len) {
-        ssize_t bytes = send(server_socket, message.data() + sent, len - sent, 0);
-        if (bytes < 0) return false; // Send failed
+        // No SIGPIPE, a closed connection is handled like one closed by the server
+        ssize_t bytes = send(server_socket, message.data() + sent, len - sent, MSG_NOSIGNAL);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) {
+            terminal.err << "ERR: send: " << strerror(errno) << '\n';
+            metrics.send_errors.add();
+            connectionLost();
+            return false; // Send failed
+        }
         sent += bytes;
     }
+    metrics.bytes_sent.add(len);
+    metrics.messages_sent.add();
+    trace.record(TraceEvent::SEND, traceType(std::string_view(reinterpret_cast<const char*>(message.data()), message.size())), 0, message.size());
 
     return true; // Message sent successfully
 }
 
-bool ChatClient::sendMessage(const std::vector<uint8_t>& message) {
-    ssize_t len = message.size();
+bool ChatClient::sendDatagram(std::span<const std::byte> message) {
+    if (their_addr.ss_family == AF_UNSPEC) {
+        terminal.err << "ERR: Destination address is not set." << '\n';
+        return false;
+    }
 
-    // Cast to const char* is needed as sendto expects a const void* for the message
-    const char* buffer = reinterpret_cast<const char*>(message.data());
+    // Datagrams are sent together by flushOutbox(), flush early only when the outbox is full
+    if (!udp_io->queue(message)) {
+        flushOutbox();
+        if (!udp_io->queue(message)) {
+            terminal.err << "ERR: UDP message is too long." << '\n';
+            metrics.send_errors.add();
+            return false;
+        }
+    }
+    metrics.bytes_sent.add(message.size());
 
-    if (their_addr == nullptr) {
-        std::cerr << "ERR: Destination address is null." << std::endl;
+    return true; // Message queued successfully
+}
+
+bool ChatClient::flushOutbox() {
+    if (tcp || !udp_io || !udp_io->pending()) return true; // No socket while reconnecting
+
+    if (udp_io->flush(server_socket, their_addr)) return true;
+
+    terminal.err << "ERR: UDP Send failed: " << strerror(errno) << '\n';
+    return false;
+}
+
+bool ChatClient::sendTracked(std::span<const std::byte> message) {
+    if (window.full()) {
+        terminal.err << "ERR: UDP send window is full." << '\n';
         return false;
     }
 
-    ssize_t bytes = sendto(server_socket, buffer, len, 0, (struct sockaddr *)their_addr, sizeof(*their_addr));
-    TimedMessage timed_msg{message, std::chrono::steady_clock::now(), 0};
+    if (!sendDatagram(message)) return false;
 
-    if (bytes < 0) {
-        std::cerr << "ERR: UDP Send failed: " << strerror(errno) << std::endl;
-        return false; // Send failed
-    }
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + rtt.timeout(0);
+    window.push(mid, message, now, deadline);
+    timers.schedule(deadline, mid);
+    mid++; // Every message gets its own ID, the next one can be sent before this one is confirmed
+
+    return true;
+}
 
-    if (!waiting_for_confirm) {
-        waiting_for_confirm = true;
-        pending = timed_msg;
+bool ChatClient::sendSerialized(size_t length) {
+    if (length == 0) {
+        terminal.err << "ERR: Message does not fit into the send buffer." << '\n';
+        return false;
     }
 
-    return true; // Message sent successfully
+    return sendMessage(std::span<const std::byte>(send_buffer.data(), length));
 }
 
 bool ChatClient::sendByeMessage() {
     ByeMessage bye_message;
+    transcribe(false, MessageType::BYE, "", "");
+
+    if (tcp) return sendSerialized(bye_message.serialize_into(send_buffer));
 
-    return tcp ? sendMessage(bye_message.serialize()) : sendMessage(bye_message.serialize(mid));
+    // Client exits right after BYE, so its CONFIRM is never awaited
+    uint16_t id = mid++;
+    size_t length = bye_message.serialize_into(send_buffer, id);
+    if (!sendDatagram(std::span<const std::byte>(send_buffer.data(), length))) return false;
+
+    metrics.messages_sent.add();
+    trace.record(TraceEvent::SEND, traceType(MessageType::BYE), id, length);
+    return true;
 }
 
 bool ChatClient::sendAuthMessage(const std::string& username, const std::string& display_name, const std::string& secret) {
     AuthMessage auth_message(username, display_name, secret);
-    return tcp ? sendMessage(auth_message.serialize()) : sendMessage(auth_message.serialize(mid));
+    return sendSerialized(tcp ? auth_message.serialize_into(send_buffer) : auth_message.serialize_into(send_buffer, mid));
 }
 
 bool ChatClient::sendJoinMessage(const std::string& channelID, const std::string& display_name) {
     JoinMessage join_message(channelID, display_name);
-    return tcp ? sendMessage(join_message.serialize()) : sendMessage(join_message.serialize(mid));
+    return sendSerialized(tcp ? join_message.serialize_into(send_buffer) : join_message.serialize_into(send_buffer, mid));
 }
 
-bool ChatClient::sendMsgMessage(const std::string& display_name, const std::string& content) {
-    MsgMessage msg_message(display_name, content);
-    return tcp ? sendMessage(msg_message.serialize()) : sendMessage(msg_message.serialize(mid));
+bool ChatClient::sendMsgMessage(const std::string& display_name, std::string_view content) {
+    // Reused between calls, assigning keeps the capacity of its strings
+    outgoing_msg.display_name = display_name;
+    outgoing_msg.message_content = content;
+    if (!sendSerialized(tcp ? outgoing_msg.serialize_into(send_buffer) : outgoing_msg.serialize_into(send_buffer, mid))) return false;
+
+    transcribe(false, MessageType::MSG, display_name, content);
+    return true;
 }
 
 bool ChatClient::sendConfirmMessage(const uint16_t message_id) {
     ConfirmMessage confirm_message(message_id);
 
-    auto message = confirm_message.serialize();
-    ssize_t len = message.size();
+    std::byte buffer[3];
+    size_t len = confirm_message.serialize_into(buffer);
+    metrics.confirms_sent.add();
 
-    // Cast to const char* is needed as sendto expects a const void* for the message
-    const char* buffer = reinterpret_cast<const char*>(message.data());
-    ssize_t bytes = sendto(server_socket, buffer, len, 0, (struct sockaddr *)their_addr, sizeof(*their_addr));
+    // Coalesced with other CONFIRMs of the same receive batch
+    return sendDatagram(std::span<const std::byte>(buffer, len));
+}
 
-    if (bytes < 0) {
-        std::cerr << "ERR: UDP Confirm Send failed" << std::endl;
-        return false; // Send failed
-    }
+bool ChatClient::confirmIncoming(const uint16_t message_id) {
+    // Duplicates are confirmed again, their previous CONFIRM may have been lost
+    if (!sendConfirmMessage(message_id)) terminal.err << "ERR: confirm message is not sent" << '\n';
 
-    return true; // Message sent successfully
+    if (seen_ids.insert(message_id)) return true;
+
+    metrics.duplicates.add();
+    return false;
 }
 
 int ChatClient::runCLI() {
-    // Setup poll structure for stdin and the server socket
-    struct pollfd fds[2];
-    fds[0].fd = server_socket;
-    fds[0].events = POLLIN;  // Check for incoming data
-    fds[1].fd = STDIN_FILENO;
-    fds[1].events = POLLIN;  // Check for input from the terminal
+    if (!config.script_path.empty()) {
+        script = std::make_unique<ScriptFile>();
+        if (!script->open(config.script_path)) {
+            terminal.err << "ERR: Cannot map script " << config.script_path << ": " << strerror(errno) << '\n';
+            terminal.flush();
+            return EXIT_FAILURE;
+        }
+        script_started = script_next = std::chrono::steady_clock::now();
+    }
 
-    std::queue<std::string> command_queue;  // Queue to hold commands when waiting for a server response
+    Reactor cli;
+    if (!cli.valid() || !attach(cli, script ? -1 : STDIN_FILENO)) {
+        terminal.flush();
+        return EXIT_FAILURE;
+    }
 
-    while (true) {
-        if (bye) return EXIT_SUCCESS;
-        else if (err) return EXIT_FAILURE;
+    traceState();
+    bool ran = cli.run(); // False if epoll_wait() failed
+    if (!ran && !done) finish(EXIT_FAILURE);
+    traceState();
 
-        const int timeout_duration = waiting_for_confirm ? 50 : -1; // Wait for 250ms if waiting for confirmation, else wait indefinitely
+    // Interrupted by a signal, the session is still attached
+    if (reactor != nullptr) detach();
+    flushTerminal();
 
-        int ret = poll(fds, 2, timeout_duration);  // Wait indefinitely until there's activity
-        if (ret == -1) {
-            // Handle error
-            std::cerr << "ERR: poll: " << strerror(errno) << std::endl;
-            break;
-        } else if (ret == 0) {
-            // Timeout occurred
-            if (waiting_for_confirm && !err) {
-                checkForTimeouts();
-            }
-            continue;
+    return exit_status;
+}
+
+bool ChatClient::attach(Reactor& reactor, int input_fd) {
+    // Without a timerfd deadlines are passed to Reactor::wakeAt() by armTimer() instead
+    this->reactor = &reactor;
+
+    // Server socket and retransmission timer
+    io_fd = tcp ? server_socket : udp_io->pollFd();
+    if (!reactor.add(io_fd, EPOLLIN, this) || (timer_fd != -1 && !reactor.add(timer_fd, EPOLLIN, this))) {
+        terminal.err << "ERR: epoll_ctl: " << strerror(errno) << '\n';
+        reactor.remove(io_fd);
+        this->reactor = nullptr;
+        return false;
+    }
+
+    if (input_fd != -1) {
+        input = std::make_unique<InputReader>();
+        this->input_fd = input_fd;
+        watchInput(true);
+    }
+
+    reactor.attach(this);
+    if (interrupted) reactor.stop();
+
+    return true;
+}
+
+void ChatClient::detach() {
+    reactor->remove(io_fd);
+    if (timer_fd != -1) reactor->remove(timer_fd);
+    watchInput(false);
+    reactor->detach(this);
+    reactor = nullptr;
+}
+
+bool ChatClient::submitLine(std::string_view line) {
+    if (done) return false;
+
+    bool taken = handleInput(line);
+    if (reactor != nullptr) reactor->schedule(this); // Sends whatever the line produced
+
+    return taken;
+}
+
+void ChatClient::mute() {
+    terminal.mute();
+}
+
+bool ChatClient::finished() const {
+    return done;
+}
+
+bool ChatClient::idle() const {
+    return command_queue.empty() && window.empty() && !waiting_for_response && !lost && !recovering;
+}
+
+int ChatClient::exitStatus() const {
+    return exit_status;
+}
+
+void ChatClient::interrupt() {
+    interrupted = true;
+    Reactor* current = reactor;
+    if (current != nullptr) current->stop();
+}
+
+void ChatClient::finish(int status) {
+    if (done) return;
+
+    done = true;
+    exit_status = status;
+    traceState();
+
+    if (script) printScriptSummary(); // Before BYE, which isn't a line of the script
+
+    // Fatal error, keep what led to it
+    if (status != EXIT_SUCCESS && !config.trace_path.empty() && dumpTrace(config.trace_path)) {
+        terminal.err << "ERR: Protocol trace written to " << config.trace_path << '\n';
+    }
+}
+
+void ChatClient::connectionLost() {
+    if (config.reconnect_attempts == 0 || done) {
+        err = true;
+        return;
+    }
+    if (lost) return;
+
+    // A failure during recovery still counts from the first one
+    auto now = std::chrono::steady_clock::now();
+    if (!recovering) lost_at = now;
+    lost = true;
+    reconnect_at = now + backoff();
+}
+
+void ChatClient::recover() {
+    if (server_socket != -1) dropConnection();
+
+    // Attempts count from lost_at until recovered(). A connection lost again before the
+    // replayed AUTH was answered (UDP has no handshake) is a failed attempt too.
+    if (reconnect_attempts < config.reconnect_attempts) {
+        if (std::chrono::steady_clock::now() < reconnect_at) return; // armTimer() wakes us up
+
+        reconnect_attempts++;
+        bool connected = reconnect();
+        trace.record(TraceEvent::RECONNECT, connected, 0, reconnect_attempts);
+        if (connected) return;
+
+        if (reconnect_attempts < config.reconnect_attempts) {
+            reconnect_at = std::chrono::steady_clock::now() + backoff();
+            return;
         }
+    }
 
-        // Check for incoming messages from the server
-        if (fds[0].revents & POLLIN) {
-            receiveMessage();
+    terminal.err << "ERR: Giving up after " << reconnect_attempts << " reconnect attempts" << '\n';
+    lost = false;
+    recovering = false;
+    err = true;
+}
+
+void ChatClient::dropConnection() {
+    requeueUnsent();
+
+    if (reactor != nullptr) reactor->remove(io_fd);
+    udp_io.reset();
+    close(server_socket);
+    server_socket = -1;
+    io_fd = -1;
+
+    // The next connection is a new session for the server
+    window = SendWindow(config.window_size);
+    timers.clear();
+    framer.reset();
+    seen_ids.clear();
+    waiting_for_auth = true;
+    waiting_for_response = false;
+    server_answered = false;
+}
+
+void ChatClient::requeueUnsent() {
+    // Authenticated or waiting for the answer, a refused AUTH is left to the user
+    replay_auth = !username.empty() && (!waiting_for_auth || waiting_for_response);
+
+    // JOIN waiting for its REPLY is sent again, otherwise the last accepted one.
+    // Lost again before the replayed AUTH was answered, the queue has it already.
+    std::vector<std::string> lines;
+    std::string rejoin = waiting_for_response && !waiting_for_auth ? channel : joined_channel;
+    if (replay_auth && !recovering && !rejoin.empty()) lines.push_back("/join " + rejoin);
+
+    // Unconfirmed UDP MSGs, TCP doesn't say which messages the server got
+    window.forEach([&lines](uint16_t, TimedMessage& pending) {
+        MsgView msg;
+        if (!pending.message_data.empty() && pending.message_data[0] == 0x04 && MsgView::parse(pending.message_data, msg)) {
+            lines.emplace_back(msg.message_content);
         }
+    });
 
-        // Check for user input from stdin
-        if (fds[1].revents & POLLIN) {
-            std::string input;
-            if (std::getline(std::cin, input)) {
-                std::istringstream iss(input);
-                std::string command;
-                std::getline(iss, command, ' '); // Extract the command part of the input
-
-                // Directly handle /rename and /help commands even if waiting for a response
-                if (command == "/rename" || command == "/help") {
-                    processCommand(input);
-                } else if (command == "/auth" || (!waiting_for_auth && !waiting_for_confirm && !waiting_for_response)) {
-                    if (command_queue.size() == 0) {
-                        processCommand(input);
-                    } else {
-                        command_queue.push(input);
-                    }
-                } else if (waiting_for_response || waiting_for_confirm) {
-                    std::cerr << "ERR: waiting for response(" << waiting_for_response << ")/confirm(" << waiting_for_confirm << ") from server" << std::endl;
-
-                    // Queue other commands when waiting for a response
-                    command_queue.push(input);
-                } else {
-                    std::cerr << "ERR: you must authenticate first" << std::endl;
-                    printHelp();
-                }
-            } else if (std::cin.eof()) {
-                std::cerr << "ERR: EOF detected on stdin. Shutting down..." << std::endl;
+    // Then what was queued, in the original order
+    for (; !command_queue.empty(); command_queue.pop()) lines.emplace_back(command_queue.front().text);
 
-                while (!waiting_for_response && command_queue.size() != 0) {
-                    std::string next_command = command_queue.front();
-                    command_queue.pop();
-                    processCommand(next_command);
-                }
+    size_t dropped = 0;
+    for (const std::string& line : lines) {
+        if (!command_queue.push(Command::parse(line))) dropped++;
+    }
+    if (dropped != 0) terminal.err << "ERR: " << dropped << " unsent commands don't fit the command queue, dropped" << '\n';
+}
 
-                return EXIT_SUCCESS;
-            } else {
-                std::cerr << "ERR: Error reading from stdin. Shutting down..." << std::endl;
-                return EXIT_FAILURE;
+bool ChatClient::reconnect() {
+    terminal.err << "ERR: Reconnecting to " << config.server_address << ", attempt " << reconnect_attempts << '\n';
+    if (!connectToServer()) return false;
+    connect_err = false;
+
+    io_fd = tcp ? server_socket : udp_io->pollFd();
+    if (reactor != nullptr && !reactor->add(io_fd, EPOLLIN, this)) {
+        terminal.err << "ERR: epoll_ctl: " << strerror(errno) << '\n';
+        dropConnection();
+        return false;
+    }
+    lost = false;
+
+    if (!replay_auth) {
+        recovered();
+        return true;
+    }
+
+    // Queued commands wait for the REPLY, like after the user's /auth
+    recovering = true;
+    if (sendAuthMessage(username, secret, display_name)) {
+        transcribe(false, MessageType::AUTH, display_name, username);
+        waiting_for_response = true;
+        auth_sent = std::chrono::steady_clock::now();
+        if (latency) latency->request_sent = latency->last_sent;
+    }
+    return !lost; // The send may have failed already
+}
+
+void ChatClient::recovered() {
+    auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - lost_at);
+    metrics.reconnects.add();
+    metrics.recovery_us.set(took.count());
+    terminal.err << "Reconnected in " << took.count() / 1000.0 << " ms after "
+                 << reconnect_attempts << (reconnect_attempts == 1 ? " attempt" : " attempts") << '\n';
+
+    recovering = false;
+    reconnect_attempts = 0;
+}
+
+std::chrono::microseconds ChatClient::backoff() {
+    if (reconnect_attempts == 0) return std::chrono::microseconds(0); // First attempt right away
+
+    std::chrono::microseconds delay = RECONNECT_MIN * (1u << std::min(reconnect_attempts - 1, 16u));
+    delay = std::min<std::chrono::microseconds>(delay, RECONNECT_MAX);
+
+    // Half of it random, clients dropped together don't all come back at once
+    return delay / 2 + std::chrono::microseconds(jitter() % (delay.count() / 2 + 1));
+}
+
+void ChatClient::onEvent(int fd, uint32_t) {
+    if (done) return;
+
+    if (fd == timer_fd) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+            armed_deadline = std::chrono::steady_clock::time_point::max(); // One-shot timer is disarmed now
+        }
+
+        if (!err && !lost) checkForTimeouts(); // While lost the timer waits for the reconnect
+    } else if (fd == io_fd) {
+        // Check for incoming messages from the server
+        receiveMessage();
+        if (drain_deadline != std::chrono::steady_clock::time_point::max()) drain_deadline = std::chrono::steady_clock::now() + drain_timeout;
+    } else if (fd == input_fd) {
+        // Check for user input, EPOLLHUP still leaves data to read
+        readInput();
+    }
+}
+
+void ChatClient::afterEvents() {
+    // Woken up by the reactor instead of the timerfd, see armTimer()
+    if (!done && timer_fd == -1 && armed_deadline <= std::chrono::steady_clock::now()) {
+        armed_deadline = std::chrono::steady_clock::time_point::max();
+        if (!err && !lost) checkForTimeouts();
+    }
+
+    // Regular files are always readable, they are read once per iteration instead
+    if (!done && input && !input_pollable && !input_blocked && !input->eof()) {
+        readInput();
+        if (reactor != nullptr) reactor->schedule(this);
+    }
+
+    if (!done && lost) recover();
+    if (!done && !lost && !err) takeInput(); // Gave up or failed, requeued commands have no socket
+
+    if (!done) {
+        if (bye) finish(EXIT_SUCCESS);
+        else if (err) finish(EXIT_FAILURE);
+        // After end of input finish everything that was read, then leave
+        else if (inputEnded() && idle()) finish(EXIT_SUCCESS);
+        else if (inputEnded()) {
+            auto now = std::chrono::steady_clock::now();
+            if (drain_deadline == std::chrono::steady_clock::time_point::max()) {
+                drain_deadline = now + drain_timeout;
+            } else if (now >= drain_deadline) {
+                // TCP has no retransmission limit, a silent server would keep us here forever
+                terminal.err << "ERR: No answer from the server within " << drain_timeout.count() << " ms after end of input, leaving" << '\n';
+                finish(EXIT_SUCCESS);
             }
         }
+    }
+
+    if (done) {
+        if (reactor != nullptr) detach();
+    } else {
+        armTimer();
+        flushOutbox(); // Everything queued in this iteration
+
+        // Backpressure: input is read again only when all lines read so far were taken
+        if (input) watchInput(!input->eof() && !input_blocked);
+    }
 
-        // If not waiting for a response and there are queued commands, process the next one
-        while (!waiting_for_response && command_queue.size() != 0) {
-            std::string next_command = command_queue.front();
-            command_queue.pop();
-            processCommand(next_command);
+    updateGauges();
+    traceState();
+    flushTerminal(); // Output is written once per iteration, before the reactor may block
+}
+
+bool ChatClient::inputEnded() const {
+    return (input && input->eof()) || (script && script->eof());
+}
+
+void ChatClient::readInput() {
+    ssize_t bytes = input->readFrom(input_fd);
+
+    if (input->dropped() != input_dropped) {
+        terminal.err << "ERR: Input line longer than " << InputReader::CAPACITY << " bytes dropped" << '\n';
+        input_dropped = input->dropped();
+    }
+
+    if (bytes == 0) {
+        terminal.err << "ERR: EOF detected on stdin. Shutting down..." << '\n';
+    } else if (bytes < 0 && errno != EINTR && errno != EAGAIN) {
+        terminal.err << "ERR: Error reading from stdin. Shutting down..." << '\n';
+        finish(EXIT_FAILURE);
+    }
+}
+
+void ChatClient::takeInput() {
+    // If not waiting for a response and there are queued commands, process the next one
+    while (!waiting_for_response && !window.full() && !command_queue.empty()) {
+        const Command& command = command_queue.front();
+        trace.record(TraceEvent::DEQUEUE, static_cast<uint8_t>(command.type), 0, command_queue.size() - 1);
+        processCommand(command);
+        command_queue.pop();
+    }
+
+    if (script) takeScript();
+    if (!input) return;
+
+    // Take every line that was read, as long as the queue has room for them
+    input_blocked = false;
+    std::string_view line;
+    while (input->nextLine(line)) {
+        if (!handleInput(line)) {
+            input->unreadLine();
+            input_blocked = true;
+            break;
         }
     }
+}
+
+void ChatClient::takeScript() {
+    auto now = std::chrono::steady_clock::now();
+    // Time spent waiting for the server isn't made up by a burst later, at most 10 ms of it
+    if (script_interval.count() != 0) script_next = std::max(script_next, now - std::chrono::milliseconds(10));
+
+    // Lines stay in the mapping until they can be sent right away, the command queue is left alone.
+    // At most -b lines per iteration, TCP never fills the window and the server must be read meanwhile.
+    std::string_view line;
+    for (unsigned taken = 0; !done && !lost && !waiting_for_response && !window.full() && command_queue.empty(); taken++) {
+        if (script_interval.count() != 0 && script_next > now) break; // armTimer() wakes us up
+
+        if (taken == config.batch_size) {
+            if (reactor != nullptr) reactor->schedule(this); // Goes on in the next iteration
+            break;
+        }
 
-    return EXIT_SUCCESS;
+        if (!script->nextLine(line)) break;
+        if (!handleInput(line)) {
+            script->unreadLine();
+            break;
+        }
+        script_next += script_interval;
+    }
 }
 
-// Example implementation of processCommand (you need to implement it based on your needs)
-void ChatClient::processCommand(const std::string& input) {
-        std::istringstream iss(input);
+void ChatClient::printScriptSummary() {
+    auto took = std::chrono::duration<double>(std::chrono::steady_clock::now() - script_started).count();
+    uint64_t sent = metrics.messages_sent.get();
+    uint64_t failed = metrics.confirm_timeouts.get() + metrics.send_errors.get() + metrics.replies_refused.get();
+
+    terminal.err << "Script: " << script->lines() << " lines in " << took * 1000.0 << " ms, " << sent << " messages sent ("
+                 << (took > 0 ? sent / took : 0.0) << "/s), ";
+    // TCP has no CONFIRM, written to the stream is all that is known
+    if (!tcp) terminal.err << metrics.messages_confirmed.get() << " confirmed, ";
+    terminal.err << failed << " failed" << '\n';
+}
 
-        std::string command;
-        std::getline(iss, command, ' '); // Extract the command part of the input
+void ChatClient::watchInput(bool watch) {
+    if (!input_pollable || watch == input_watched) return;
+
+    // Removed rather than left with no events, epoll would keep reporting a hangup
+    if (!watch) {
+        reactor->remove(input_fd);
+        input_watched = false;
+    } else if (reactor->add(input_fd, EPOLLIN, this)) {
+        input_watched = true;
+    } else if (errno == EPERM) {
+        input_pollable = false;
+    } else {
+        terminal.err << "ERR: epoll_ctl (input): " << strerror(errno) << '\n';
+        finish(EXIT_FAILURE);
+    }
+}
 
-        std::vector<std::string> params;
-        std::string param;
-        while (std::getline(iss, param, ' ')) {
-            params.push_back(param);
+bool ChatClient::handleInput(std::string_view line) {
+    Command command = Command::parse(line); // Parsed once, queued commands keep their fields
+
+    // Directly handle /rename and /help commands even if waiting for a response
+    if (command.name == "/rename" || command.name == "/help" || command.name == "/latency" || command.name == "/stats" || command.name == "/trace") {
+        processCommand(command);
+    } else if (lost) {
+        // Sent once the connection is back
+        return command_queue.push(command);
+    } else if (command.name == "/auth" || (!waiting_for_auth && !window.full() && !waiting_for_response)) {
+        if (command_queue.empty()) {
+            processCommand(command);
+        } else {
+            return command_queue.push(command);
         }
+    } else if (waiting_for_response || window.full()) {
+        // Queue other commands when waiting for a response
+        if (!command_queue.push(command)) return false;
+
+        terminal.err << "ERR: waiting for response(" << waiting_for_response << ")/confirm(" << window.full() << ") from server" << '\n';
+    } else {
+        terminal.err << "ERR: you must authenticate first" << '\n';
+        printHelp();
+    }
+
+    return true;
+}
+
+void ChatClient::processCommand(const Command& command) {
+    const std::string_view* params = command.params;
 
-        if (command == "/auth" && params.size() == 3 && isValidId(params[0]) && isValidSecret(params[1]) && isValidDName(params[2])) {
+    switch (command.type) {
+        case CommandType::AUTH:
             if (waiting_for_auth) {
-                if (sendAuthMessage(params[0], params[1], params[2])) {
+                if (sendAuthMessage(std::string(params[0]), std::string(params[1]), std::string(params[2]))) {
                     username = params[0];
                     secret = params[1];
                     display_name = params[2];
+                    transcribe(false, MessageType::AUTH, display_name, username); // Without the secret
                     waiting_for_response = true;
+                    auth_sent = std::chrono::steady_clock::now();
+                    if (latency) latency->request_sent = latency->last_sent;
                 }
             } else {
-                std::cerr << "ERR: Trying to send multiple /auth" << std::endl;
+                terminal.err << "ERR: Trying to send multiple /auth" << '\n';
             }
-        } else if (command == "/join" && params.size() == 1 && isValidId(params[0])) {
-            if (sendJoinMessage(params[0], display_name)) {
+            break;
+        case CommandType::JOIN:
+            if (sendJoinMessage(std::string(params[0]), display_name)) {
+                channel = params[0];
+                transcribe(false, MessageType::JOIN, display_name, channel);
                 waiting_for_response = true;
+                if (latency) latency->request_sent = latency->last_sent;
             }
-        } else if (command == "/rename" && params.size() == 1 && isValidDName(params[0])) {
+            break;
+        case CommandType::RENAME:
             display_name = params[0]; // Update the display name
-        } else if (command == "/help") {
+            break;
+        case CommandType::HELP:
             printHelp();
-        } else {
-            if (input[0] == '/') {
-                std::cerr << "ERR: Invalid command or parameter(s). ||" << input << "||" << std::endl;
-            } else {
-                sendMsgMessage(display_name, input);
+            break;
+        case CommandType::LATENCY:
+            printLatency();
+            break;
+        case CommandType::STATS:
+            printMetrics();
+            break;
+        case CommandType::TRACE:
+            {
+                std::string path = command.params[0].empty() ? config.trace_path : std::string(command.params[0]);
+                if (path.empty()) {
+                    terminal.err << "ERR: No trace file, use /trace <file>" << '\n';
+                } else if (dumpTrace(path)) {
+                    terminal.err << "Protocol trace written to " << path << '\n';
+                } else {
+                    terminal.err << "ERR: Cannot write trace to " << path << ": " << strerror(errno) << '\n';
+                }
+                break;
             }
-        }
+        case CommandType::MSG:
+            sendMsgMessage(display_name, command.text);
+            break;
+        case CommandType::INVALID:
+        default:
+            terminal.err << "ERR: Invalid command or parameter(s). ||" << command.text << "||" << '\n';
+            break;
+    }
 }
 
-void ChatClient::processMessage(const std::string& message) {
-    MessageType type = determineMessageType(message);
-    switch (type) {
-        case MessageType::ERR:
-            {
-                ErrorMessage msg = ErrorMessage::deserialize(message);
+void ChatClient::processMessage(std::string_view message) {
+    TextView msg = TextView::parse(message);
+    metrics.messages_received.add();
+    trace.record(TraceEvent::RECV, traceType(msg.type), 0, message.size());
 
-                std::cerr << "ERR FROM " << msg.display_name << ": " << msg.message_content << std::endl;
+    switch (msg.type) {
+        case MessageType::ERR:
+            terminal.err << "ERR FROM " << msg.display_name << ": " << msg.message_content << '\n';
+            transcribe(true, MessageType::ERR, msg.display_name, msg.message_content);
 
-                err = true;
+            err = true;
 
-                break;
-            }
+            break;
         case MessageType::BYE:
             bye = true;
-            std::cerr << "ERR: Received BYE message. Exiting..." << std::endl;
+            terminal.err << "ERR: Received BYE message. Exiting..." << '\n';
+            transcribe(true, MessageType::BYE, "", "");
             break;
         case MessageType::MSG:
-            {
-                MsgMessage msg = MsgMessage::deserialize(message);
+            terminal.out << msg.display_name << ": " << msg.message_content << '\n';
+            transcribe(true, MessageType::MSG, msg.display_name, msg.message_content);
 
-                std::cout << msg.display_name << ": " << msg.message_content << std::endl;
+            if (observer != nullptr) observer->onMessage(msg.display_name, msg.message_content);
+            if (latency) latency->arrived();
 
-                break;
-            }
+            break;
         case MessageType::REPLY:
-            {
-                ReplyMessage msg = ReplyMessage::deserialize(message);
-
-                if (msg.success && waiting_for_auth) waiting_for_auth = false;
-
-                std::cerr << (msg.success ? "Success: " : "Failure: ") << msg.message_content << std::endl;
-
-                waiting_for_response = false;
-
-                break;
-            }
+            handleReply(msg.success, msg.message_content);
+            break;
         case MessageType::UNKNOWN:
         default:
             {
-                std::cerr << "ERR: Unknown or malformed UDP message received." << std::endl;
+                terminal.err << "ERR: Unknown or malformed message received." << '\n';
+                metrics.unknown_messages.add();
 
-                ErrorMessage msg(display_name, message);
+                ErrorMessage error(display_name, std::string(message));
+                transcribe(false, MessageType::ERR, display_name, error.message_content);
 
-                sendMessage(msg.serialize());
+                sendSerialized(error.serialize_into(send_buffer));
 
                 err = true;
 
@@ -399,16 +903,31 @@ void ChatClient::processMessage(const std::string& message) {
     }
 }
 
-void ChatClient::processMessage(const std::vector<uint8_t>& message) {
+void ChatClient::processMessage(std::span<const uint8_t> message) {
     MessageType type = determineMessageType(message);
+    if (type == MessageType::CONFIRM) {
+        metrics.confirms_received.add();
+    } else {
+        metrics.messages_received.add();
+
+        uint16_t message_id = 0;
+        udp_view::readId(message, message_id);
+        trace.record(TraceEvent::RECV, message.empty() ? TRACE_UNKNOWN_TYPE : message[0], message_id, message.size());
+    }
+
     switch (type) {
         case MessageType::ERR:
             {
-                ErrorMessage msg = ErrorMessage::deserialize(message);
+                ErrorView msg;
+                if (!ErrorView::parse(message, msg)) {
+                    rejectMessage(message);
+                    break;
+                }
 
-                if (!sendConfirmMessage(msg.mid)) std::cerr << "ERR: confirm message is not sent" << std::endl;
+                if (!confirmIncoming(msg.mid)) break; // Retransmission, already processed
 
-                std::cerr << "ERR FROM " << msg.display_name << ": " << msg.message_content << std::endl;
+                terminal.err << "ERR FROM " << msg.display_name << ": " << msg.message_content << '\n';
+                transcribe(true, MessageType::ERR, msg.display_name, msg.message_content);
 
                 err = true;
 
@@ -416,126 +935,358 @@ void ChatClient::processMessage(const std::vector<uint8_t>& message) {
             }
         case MessageType::BYE:
             bye = true;
-            std::cerr << "ERR: Received BYE message. Exiting..." << std::endl;
+            terminal.err << "ERR: Received BYE message. Exiting..." << '\n';
+            transcribe(true, MessageType::BYE, "", "");
             break;
         case MessageType::MSG:
             {
-                MsgMessage msg = MsgMessage::deserialize(message);
+                MsgView msg;
+                if (!MsgView::parse(message, msg)) {
+                    rejectMessage(message);
+                    break;
+                }
+
+                if (!confirmIncoming(msg.mid)) break; // Retransmission, already processed
 
-                if (!sendConfirmMessage(msg.mid)) std::cerr << "ERR: confirm message is not sent" << std::endl;
+                terminal.out << msg.display_name << ": " << msg.message_content << '\n';
+                transcribe(true, MessageType::MSG, msg.display_name, msg.message_content);
 
-                std::cout << msg.display_name << ": " << msg.message_content << std::endl;
+                if (observer != nullptr) observer->onMessage(msg.display_name, msg.message_content);
+                if (latency) latency->arrived();
 
                 break;
             }
         case MessageType::REPLY:
             {
-                ReplyMessage msg = ReplyMessage::deserialize(message);
-
-                if (!sendConfirmMessage(msg.mid)) std::cerr << "ERR: confirm message is not sent" << std::endl;
-
-                if (msg.success && waiting_for_auth) waiting_for_auth = false;
-
-                std::cerr << (msg.success ? "Success: " : "Failure: ") << msg.message_content << std::endl;
+                ReplyView msg;
+                if (!ReplyView::parse(message, msg)) {
+                    rejectMessage(message);
+                    break;
+                }
 
-                waiting_for_response = false;
+                if (!confirmIncoming(msg.mid)) break; // Retransmission, already processed
 
+                handleReply(msg.success, msg.message_content);
                 break;
             }
         case MessageType::CONFIRM:
             {
-                ConfirmMessage msg = ConfirmMessage::deserialize(message);
-
-                if (msg.message_id == mid) {
-                    if (!checkForTimeouts()) {
-                        pending = TimedMessage();
-                        mid++;
-                        waiting_for_confirm = false;
-                    } else {
-                        
-                    }
+                ConfirmView msg;
+                if (!ConfirmView::parse(message, msg)) {
+                    rejectMessage(message);
+                    break;
+                }
+
+                // Karn's rule: a retransmitted message can't tell which copy was confirmed
+                TimedMessage* pending = window.find(msg.ref_mid);
+                if (pending != nullptr && pending->retry_count == 0) {
+                    rtt.sample(std::chrono::steady_clock::now() - pending->send_time);
+                }
+                // Latency as the user sees it, retransmissions included
+                if (pending != nullptr && latency) latency->confirm.record(std::chrono::steady_clock::now() - pending->first_send_time);
+
+                uint32_t waited = TRACE_UNEXPECTED;
+                if (pending != nullptr) {
+                    waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pending->first_send_time).count();
+                }
+                trace.record(TraceEvent::CONFIRM, traceType(MessageType::CONFIRM), msg.ref_mid, waited);
+
+                if (window.confirm(msg.ref_mid)) {
+                    metrics.messages_confirmed.add();
                 } else {
-                    std::cerr << "ERR: caught CONFIRM with wrong message ID" << std::endl;
+                    terminal.err << "ERR: caught CONFIRM with wrong message ID" << '\n';
+                    metrics.unexpected_confirms.add();
                 }
 
                 break;
             }
         default:
-            std::cerr << "ERR: Unknown or malformed UDP message received." << std::endl;
+            rejectMessage(message);
+            break;
+    }
+}
 
-            UnknownMessage umsg(message);
+void ChatClient::handleReply(bool success, std::string_view content) {
+    bool auth_reply = waiting_for_auth;
+    if (waiting_for_auth && waiting_for_response) {
+        auto waited = std::chrono::steady_clock::now() - auth_sent;
+        metrics.auth_wait_us.add(std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+    }
+    if (success && waiting_for_auth) waiting_for_auth = false;
+    if (success && !auth_reply && waiting_for_response) joined_channel = channel;
+    if (!success) metrics.replies_refused.add();
 
-            if (!sendConfirmMessage(umsg.message_id)) std::cerr << "ERR: confirm message is not sent" << std::endl;
+    terminal.err << (success ? "Success: " : "Failure: ") << content << '\n';
+    transcribe(true, MessageType::REPLY, success ? "OK" : "NOK", content);
 
-            ErrorMessage msg(display_name);
+    if (latency && waiting_for_response) latency->reply.record(std::chrono::steady_clock::now() - latency->request_sent);
+    waiting_for_response = false;
 
-            sendMessage(msg.serialize(umsg.payload, mid));
+    if (recovering && auth_reply) recovered();
 
-            break;
-    }
+    if (observer != nullptr) observer->onReply(success, content);
+}
+
+void ChatClient::rejectMessage(std::span<const uint8_t> message) {
+    terminal.err << "ERR: Unknown or malformed UDP message received." << '\n';
+    metrics.unknown_messages.add();
+
+    uint16_t message_id;
+    if (udp_view::readId(message, message_id) && !confirmIncoming(message_id)) return; // Retransmission, already processed
+
+    ErrorMessage msg(display_name);
+    transcribe(false, MessageType::ERR, display_name, "Unknown or malformed message");
+
+    sendSerialized(msg.serialize_into(send_buffer, message, mid));
 }
 
 void ChatClient::receiveMessage() {
     if (tcp) {
-        char buffer[1500] = {};
-        ssize_t bytes_received = recv(server_socket, buffer, sizeof(buffer), 0);
+        ssize_t bytes_received = recv(server_socket, framer.writePtr(), framer.writable(), 0);
+
+        if (bytes_received == 0) {
+            terminal.err << "ERR: Server closed the connection." << '\n';
+            connectionLost();
+            return;
+        } else if (bytes_received < 0) {
+            if (errno == EINTR || errno == EAGAIN) return;
+            terminal.err << "ERR: recv: " << strerror(errno) << '\n';
+            connectionLost(); // Reset or timed out, epoll would keep reporting it
+            return;
+        }
 
-        std::string message;
-        if (bytes_received > 0) message.assign(buffer, bytes_received);
+        framer.commit(bytes_received);
+        metrics.bytes_received.add(bytes_received);
+        if (latency) latency->received = std::chrono::steady_clock::now();
 
-        // std::cerr << "||" << message << "||" << std::endl;
+        // One segment may carry several messages or only a part of one
+        std::string_view frame;
+        while (!bye && !err && framer.nextFrame(frame)) {
+            processMessage(frame);
+            flushTerminal(true);
+        }
 
-        if (!message.empty()) processMessage(message);
+        if (framer.overflow()) {
+            terminal.err << "ERR: Incoming message exceeds " << LineFramer::CAPACITY << " bytes." << '\n';
+            err = true;
+        }
     } else {
-        std::vector<uint8_t> buffer(1500);
-        struct sockaddr_in sender_addr;
-        socklen_t sender_addr_len = sizeof(sender_addr);
-
-        ssize_t bytes_received = recvfrom(server_socket, buffer.data(), buffer.size(), 0, (struct sockaddr*)&sender_addr, &sender_addr_len);
+        int count = udp_io->receive(server_socket);
+        if (count < 0 && (errno == ECONNREFUSED || errno == EHOSTUNREACH || errno == ENETUNREACH)) {
+            candidateRefused();
+            return;
+        }
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) terminal.err << "ERR: " << udp_io->name() << ": " << strerror(errno) << '\n';
+            return;
+        }
+        if (latency) latency->received = std::chrono::steady_clock::now();
 
-        if (bytes_received > 0) {
-            their_addr->sin_family = sender_addr.sin_family;
-            their_addr->sin_port = sender_addr.sin_port;
-            their_addr->sin_addr = sender_addr.sin_addr;
+        for (int i = 0; i < count && !bye && !err; i++) {
+            their_addr = udp_io->sender(i);
+            server_answered = true;
+            metrics.bytes_received.add(udp_io->datagram(i).size());
 
-            processMessage(std::vector<uint8_t>(buffer.begin(), buffer.begin() + bytes_received));
+            // Parsed in place, views point directly into the batch buffer
+            if (udp_io->truncated(i)) {
+                rejectMessage(udp_io->datagram(i));
+            } else {
+                processMessage(udp_io->datagram(i));
+            }
+            flushTerminal(true);
         }
+
+        // CONFIRMs and replies of the whole batch go out together
+        flushOutbox();
     }
 }
 
 void ChatClient::printHelp() {
-    std::cout << "Available commands:" << std::endl;
-    std::cout << "/auth <Username> <Secret> <DisplayName> - Authenticate with the server." << std::endl;
-    std::cout << "/join <ChannelID> - Join a chat channel." << std::endl;
-    std::cout << "/rename <DisplayName> - Change your display name." << std::endl;
-    std::cout << "/help - Show help message." << std::endl;
+    terminal.out << "Available commands:" << '\n';
+    terminal.out << "/auth <Username> <Secret> <DisplayName> - Authenticate with the server." << '\n';
+    terminal.out << "/join <ChannelID> - Join a chat channel." << '\n';
+    terminal.out << "/rename <DisplayName> - Change your display name." << '\n';
+    terminal.out << "/help - Show help message." << '\n';
+    terminal.out << "/latency - Show latency histograms (with -l)." << '\n';
+    terminal.out << "/stats - Show counters and gauges as key=value pairs." << '\n';
+    terminal.out << "/trace [file] - Write recent protocol events to a file (read by ipk24chat-tracedump)." << '\n';
 }
 
 void ChatClient::closeConnection() {
-    if (!bye) sendByeMessage();
+    if (!bye && server_socket != -1) sendByeMessage(); // No connection while reconnecting
+
+    flushOutbox();
 
-    // if (!tcp && waiting_for_confirm && !err) {
-    //     receiveMessage();
-    // }
+    if (transcript) transcript->stop(); // Everything up to BYE is written before the counters are printed
+
+    printStats();
+}
+
+void ChatClient::printStats() {
+    if (transcript) {
+        terminal.err << "Transcript: " << transcript->written() << " records written in " << transcript->batches()
+                     << " batches, " << transcript->dropped() << " dropped" << '\n';
+        if (transcript->error() != 0) terminal.err << "ERR: Transcript write failed: " << strerror(transcript->error()) << '\n';
+    }
+
+    if (latency) printLatency();
+}
+
+void ChatClient::printLatency() {
+    if (!latency) {
+        terminal.err << "ERR: Latency histograms are recorded only with -l" << '\n';
+        return;
+    }
+
+    if (!tcp) latency->confirm.print(terminal.err, "CONFIRM");
+    latency->reply.print(terminal.err, "REPLY");
+    latency->output.print(terminal.err, "Output");
+}
+
+void ChatClient::updateGauges() {
+    metrics.command_queue.set(command_queue.size());
+    metrics.command_queue_high_water.set(command_queue.highWater());
+    metrics.window_in_flight.set(window.inFlight());
+    metrics.rto_us.set(rtt.rto().count());
+    metrics.srtt_us.set(rtt.srtt().count());
+    if (!tcp && udp_io) {
+        const DatagramIO::Stats& stats = udp_io->stats();
+        metrics.udp_recv_calls.set(stats.recv_calls);
+        metrics.udp_recv_datagrams.set(stats.recv_datagrams);
+        metrics.udp_send_calls.set(stats.send_calls);
+        metrics.udp_send_datagrams.set(stats.send_datagrams);
+    }
+    if (transcript) {
+        metrics.transcript_written.set(transcript->written());
+        metrics.transcript_dropped.set(transcript->dropped());
+    }
+}
+
+void ChatClient::printMetrics() {
+    updateGauges();
+
+    char line[Metrics::LINE_SIZE];
+    size_t length = metrics.format(line, sizeof(line));
+    terminal.err << std::string_view(line, length) << '\n';
+}
+
+void ChatClient::transcribe(bool received, MessageType type, std::string_view name, std::string_view text) {
+    if (transcript) transcript->push(received, traceType(type), name, text);
+}
+
+void ChatClient::traceState() {
+    uint32_t state = (waiting_for_auth ? trace_state::WAITING_FOR_AUTH : 0)
+                   | (waiting_for_response ? trace_state::WAITING_FOR_RESPONSE : 0)
+                   | (window.full() ? trace_state::WINDOW_FULL : 0)
+                   | (input_blocked ? trace_state::INPUT_BLOCKED : 0)
+                   | (bye ? trace_state::BYE : 0)
+                   | (err ? trace_state::ERR : 0)
+                   | (done ? trace_state::DONE : 0)
+                   | (lost || recovering ? trace_state::RECONNECTING : 0);
+
+    if (state == traced_state && trace.recorded() != 0) return;
+
+    trace.record(TraceEvent::STATE, 0, 0, state);
+    traced_state = state;
+}
+
+bool ChatClient::dumpTrace(std::string_view path) {
+    return trace.dump(std::string(path));
+}
+
+void ChatClient::dumpMetrics(int fd) const {
+    metrics.dump(fd);
+}
+
+void ChatClient::flushTerminal(bool due_only) {
+    if (due_only) terminal.flushIfDue();
+    else terminal.flush();
+
+    // Received MSGs reached stdout once the buffer is empty
+    if (!latency || latency->unwritten_count == 0 || terminal.out.size() != 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < latency->unwritten_count; i++) latency->output.record(now - latency->unwritten[i]);
+    latency->unwritten_count = 0;
 }
 
 bool ChatClient::checkForTimeouts() {
     auto now = std::chrono::steady_clock::now();
-    
-    if (!pending.message_data.empty()) {
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - pending.send_time) > TIMEOUT) {
-            if (pending.retry_count < MAX_RETRIES) {
-                sendMessage(pending.message_data);
-                pending.send_time = now;
-                pending.retry_count++;
-                std::cerr << "ERR: Timeout, retransmitting. Message ID: " << mid << std::endl;
-                return true;
-            } else {
-                err = true;
-                std::cerr << "ERR: Max retry count reached" << std::endl;
-                // exit here
-            }
+    bool retransmitted = false;
+
+    while (!err && !lost && !timers.empty() && timers.top().deadline <= now) {
+        TimerQueue::Timer timer = timers.top();
+        timers.pop();
+
+        // Skip timers of confirmed messages and of already rescheduled ones
+        TimedMessage* pending = window.find(timer.message_id);
+        if (pending == nullptr || pending->deadline != timer.deadline) continue;
+
+        if (pending->retry_count < MAX_RETRIES) {
+            // Until the server answers, every retransmission goes to the next resolved address
+            if (nextCandidate()) terminal.err << "ERR: No answer, trying " << addressString(their_addr) << '\n';
+            sendDatagram(std::as_bytes(std::span(pending->message_data)));
+            pending->send_time = now;
+            pending->retry_count++;
+            pending->deadline = now + rtt.timeout(pending->retry_count);
+            timers.schedule(pending->deadline, timer.message_id);
+            terminal.err << "ERR: Timeout, retransmitting. Message ID: " << timer.message_id
+                      << " (RTO " << std::chrono::duration_cast<std::chrono::milliseconds>(pending->deadline - now).count() << " ms)" << '\n';
+            retransmitted = true;
+            metrics.retransmissions.add();
+            trace.record(TraceEvent::RETRANSMIT, pending->message_data.empty() ? TRACE_UNKNOWN_TYPE : pending->message_data[0],
+                         timer.message_id, pending->retry_count);
+        } else {
+            terminal.err << "ERR: Max retry count reached" << '\n';
+            metrics.confirm_timeouts.add();
+            trace.record(TraceEvent::GIVE_UP, pending->message_data.empty() ? TRACE_UNKNOWN_TYPE : pending->message_data[0],
+                         timer.message_id, pending->retry_count);
+            connectionLost();
         }
     }
-    return false;
-}
\ No newline at end of file
+
+    return retransmitted;
+}
+
+void ChatClient::armTimer() {
+    if (window.empty()) {
+        timers.clear(); // Everything left there is stale
+    }
+
+    // Drop confirmed messages from the top, so that the timer fires only for a real deadline
+    while (!timers.empty()) {
+        const TimerQueue::Timer& timer = timers.top();
+        TimedMessage* pending = window.find(timer.message_id);
+        if (pending != nullptr && pending->deadline == timer.deadline) break;
+        timers.pop();
+    }
+
+    auto deadline = timers.empty() ? std::chrono::steady_clock::time_point::max() : timers.top().deadline;
+    deadline = std::min(deadline, drain_deadline);
+    if (lost) deadline = reconnect_at;
+    else if (script && !script->eof() && script_next > std::chrono::steady_clock::now()) deadline = std::min(deadline, script_next);
+    if (deadline == armed_deadline) return;
+
+    // Fallback when timerfd_create() failed, the reactor shortens its epoll_wait() timeout for us
+    if (timer_fd == -1) {
+        if (reactor != nullptr) reactor->wakeAt(this, deadline);
+        armed_deadline = deadline;
+        return;
+    }
+
+    struct itimerspec spec = {};
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        spec.it_value.tv_sec = since_epoch / 1000000000;
+        spec.it_value.tv_nsec = since_epoch % 1000000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1; // Zero would disarm
+    }
+
+    // Zero it_value disarms the timer, so nothing wakes us up when nothing is pending
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        terminal.err << "ERR: timerfd_settime: " << strerror(errno) << '\n';
+        return;
+    }
+
+    armed_deadline = deadline;
+}
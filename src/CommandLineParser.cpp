@@ -1,13 +1,30 @@
 #include "CommandLineParser.h"
+#include "SendWindow.h"
+#include "Transcript.h"
 #include <cstring>
+#include <getopt.h>
 
 void CommandLineParser::printUsage() {
-    std::cerr << "usage: ipk24chat-client -s <server_ip_or_hostname> -p <port> -t <tcp_or_udp> [-d <udp_confirmation_timeout>] [-r <udp_retransmissions>]\n";
+    std::cerr << "usage: ipk24chat-client -s <server_ip_or_hostname> -p <port> -t <tcp_or_udp> [-c <connect_timeout>] [-d <udp_confirmation_timeout>] [-r <udp_retransmissions>] [-w <udp_window_size>] [-b <udp_batch_size>] [-i <udp_io_backend>] [-l] [-o <trace_file>] [-R <reconnect_attempts>] [-f <script_file> [--rate <lines_per_second>]] [-T <transcript_file> [--transcript-rotate <MiB>] [--transcript-fsync <policy>]]\n";
     std::cout << "  -t tcp|udp\tTransport protocol used for connection (required).\n";
     std::cout << "  -s <host>\tServer IP address or hostname (required).\n";
     std::cout << "  -p <port>\tServer port, default is 4567 (optional).\n";
-    std::cout << "  -d <timeout>\tUDP confirmation timeout in milliseconds, default is 250 (optional).\n";
+    std::cout << "  -c <timeout>\tMilliseconds for resolving the server and connecting to it, default is 5000 (optional).\n";
+    std::cout << "\t\tAfter end of input the server may stay silent this long too, for UDP at least as long as the -d/-r retransmissions take.\n";
+    std::cout << "  -d <timeout>\tInitial UDP confirmation timeout in milliseconds, default is 250 (optional).\n";
     std::cout << "  -r <retransmissions>\tMaximum number of UDP retransmissions, default is 3 (optional).\n";
+    std::cout << "  -w <window>\tMaximum number of unconfirmed UDP messages in flight, default is 1 (optional).\n";
+    std::cout << "  -b <batch>\tMaximum number of UDP datagrams received or sent by one system call, default is 16 (optional).\n";
+    std::cout << "  -i batch|uring\tUDP socket I/O, recvmmsg()/sendmmsg() or io_uring, default is batch (optional).\n";
+    std::cout << "  -l\t\tRecords latency histograms, printed at exit and by /latency (optional).\n";
+    std::cout << "  -o <file>\tProtocol trace written by /trace and on fatal errors, default is none (optional).\n";
+    std::cout << "  -R <attempts>\tReconnects up to <attempts> times after the connection is lost, replaying /auth and /join, default is 0 (optional).\n";
+    std::cout << "\t\tAttempts start 100 ms apart and back off up to 5 s, so 5 of them cover about 1 s and 10 about 15 s.\n";
+    std::cout << "  -f <file>\tSends the lines of <file> instead of reading stdin, as fast as the protocol allows (optional).\n";
+    std::cout << "  --rate <N>/s\tSends at most <N> script lines per second, default is no limit (optional).\n";
+    std::cout << "  -T <file>\tAppends every sent and received message with a timestamp to <file> (optional).\n";
+    std::cout << "  --transcript-rotate <MiB>\tRenames the transcript to <file>.<n> once it exceeds <MiB>, default is never (optional).\n";
+    std::cout << "  --transcript-fsync none|rotate|batch\tSyncs the transcript never, on rotation and exit, or after every batch, default is rotate (optional).\n";
     std::cout << "  -h\t\tPrints this help output and exits.\n";
 }
 
@@ -17,8 +34,20 @@ void CommandLineParser::printConfig(AppConfig config) {
     std::cout << "\nTransport protocol:\t" << config.transport_protocol
               << "\nServer IP or hostname:\t" << config.server_address
               << "\nServer port:\t" << config.port
+              << "\nConnect timeout:\t" << config.connect_timeout
               << "\nUDP confirmation timeout:\t" << config.timeout
               << "\nMaximum number of UDP retransmissions:\t" << static_cast<int>(config.retransmissions_number)
+              << "\nUDP send window size:\t" << config.window_size
+              << "\nUDP batch size:\t" << config.batch_size
+              << "\nUDP I/O backend:\t" << config.io_backend
+              << "\nLatency histograms:\t" << (config.latency ? "on" : "off")
+              << "\nTrace file:\t" << (config.trace_path.empty() ? "none" : config.trace_path)
+              << "\nReconnect attempts:\t" << config.reconnect_attempts
+              << "\nScript file:\t" << (config.script_path.empty() ? "stdin" : config.script_path)
+              << "\nScript rate:\t" << config.script_rate
+              << "\nTranscript:\t" << (config.transcript_path.empty() ? "off" : config.transcript_path)
+              << "\nTranscript rotation (MiB):\t" << config.transcript_rotate
+              << "\nTranscript fsync:\t" << config.transcript_fsync
               << std::endl;
 }
 
@@ -27,9 +56,18 @@ AppConfig CommandLineParser::parseArguments(int argc, char* argv[]) {
 
     std::string server_address, transport_protocol;
 
+    // Long options have no short form, their codes are past any character
+    enum { RATE = 256, TRANSCRIPT_ROTATE, TRANSCRIPT_FSYNC };
+    static const struct option long_options[] = {
+        {"rate", required_argument, nullptr, RATE},
+        {"transcript-rotate", required_argument, nullptr, TRANSCRIPT_ROTATE},
+        {"transcript-fsync", required_argument, nullptr, TRANSCRIPT_FSYNC},
+        {nullptr, 0, nullptr, 0},
+    };
+
     int opt;
 
-    while((opt = getopt(argc, argv, "t:s:p:d:r:h")) != -1) {
+    while((opt = getopt_long(argc, argv, "t:s:p:c:d:r:w:b:i:lo:R:f:T:h", long_options, nullptr)) != -1) {
         switch(opt) {
             case 't':
                 if (strcmp(optarg, "udp") || strcmp(optarg, "tcp")) {
@@ -52,6 +90,17 @@ AppConfig CommandLineParser::parseArguments(int argc, char* argv[]) {
                     return config;
                 }
                 break;
+            case 'c':
+                try {
+                    int connect_timeout = std::stoi(optarg);
+                    if (connect_timeout < 1) throw std::out_of_range("expected a positive number");
+                    config.connect_timeout = connect_timeout;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong connect timeout : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
             case 'd':
                 try {
                     config.timeout = std::stoi(optarg);
@@ -70,6 +119,97 @@ AppConfig CommandLineParser::parseArguments(int argc, char* argv[]) {
                     return config;
                 }
                 break;
+            case 'w':
+                try {
+                    int window = std::stoi(optarg);
+                    if (window < 1 || window > SendWindow::MAX_SIZE) throw std::out_of_range("expected 1-32768");
+                    config.window_size = window;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong window size : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case 'b':
+                try {
+                    int batch = std::stoi(optarg);
+                    if (batch < 1 || batch > 1024) throw std::out_of_range("expected 1-1024");
+                    config.batch_size = batch;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong batch size : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case 'i':
+                if (strcmp(optarg, "batch") == 0 || strcmp(optarg, "uring") == 0) {
+                    config.io_backend = optarg;
+                } else {
+                    std::cerr << "ERR: Wrong I/O backend name!" << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case 'l':
+                config.latency = true;
+                break;
+            case 'o':
+                config.trace_path = optarg;
+                break;
+            case 'R':
+                try {
+                    int attempts = std::stoi(optarg);
+                    if (attempts < 0 || attempts > 65535) throw std::out_of_range("expected 0-65535");
+                    config.reconnect_attempts = attempts;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong reconnect attempts : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case 'f':
+                config.script_path = optarg;
+                break;
+            case RATE:
+                try {
+                    // "1000" and "1000/s" both mean 1000 lines per second
+                    size_t end;
+                    long rate = std::stol(optarg, &end);
+                    std::string_view unit(optarg + end);
+                    if (!unit.empty() && unit != "/s") throw std::invalid_argument("expected <N>/s");
+                    if (rate < 1 || rate > 10000000) throw std::out_of_range("expected 1-10000000");
+                    config.script_rate = rate;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong script rate : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case 'T':
+                config.transcript_path = optarg;
+                break;
+            case TRANSCRIPT_ROTATE:
+                try {
+                    int rotate = std::stoi(optarg);
+                    if (rotate < 0 || rotate > 1048576) throw std::out_of_range("expected 0-1048576");
+                    config.transcript_rotate = rotate;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERR: Wrong transcript rotation size : " << e.what() << std::endl;
+                    config.valid = false;
+                    return config;
+                }
+                break;
+            case TRANSCRIPT_FSYNC:
+                {
+                    TranscriptSync sync;
+                    if (!Transcript::parseSync(optarg, sync)) {
+                        std::cerr << "ERR: Wrong transcript fsync policy!" << std::endl;
+                        config.valid = false;
+                        return config;
+                    }
+                    config.transcript_fsync = optarg;
+                    break;
+                }
             case 'h':
                 config.show_help = true;
                 break;
@@ -80,5 +220,11 @@ AppConfig CommandLineParser::parseArguments(int argc, char* argv[]) {
         }
     }
 
+    if (config.script_rate != 0 && config.script_path.empty()) {
+        std::cerr << "ERR: --rate paces only a script given by -f" << std::endl;
+        config.valid = false;
+        return config;
+    }
+
     return config;
 }
\ No newline at end of file
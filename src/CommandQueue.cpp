@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstring>
+
+#include "CommandQueue.h"
+#include "ValidationHelpers.h"
+
+Command Command::parse(std::string_view line) {
+    Command command;
+    command.text = line;
+
+    std::string_view rest = line;
+    command.name = rest.substr(0, rest.find(' ')); // Extract the command part of the input
+    rest.remove_prefix(std::min(rest.size(), command.name.size() + 1));
+
+    if (line.empty() || line[0] != '/') {
+        command.type = CommandType::MSG;
+        return command;
+    }
+
+    // Parameters are separated by single spaces, only as many as any command takes are kept
+    size_t count = 0;
+    while (!rest.empty()) {
+        std::string_view param = rest.substr(0, rest.find(' '));
+        rest.remove_prefix(std::min(rest.size(), param.size() + 1));
+        if (count < 3) command.params[count] = param;
+        count++;
+    }
+
+    const std::string_view* p = command.params;
+    if (command.name == "/auth" && count == 3 && isValidId(p[0]) && isValidSecret(p[1]) && isValidDName(p[2])) {
+        command.type = CommandType::AUTH;
+    } else if (command.name == "/join" && count == 1 && isValidId(p[0])) {
+        command.type = CommandType::JOIN;
+    } else if (command.name == "/rename" && count == 1 && isValidDName(p[0])) {
+        command.type = CommandType::RENAME;
+    } else if (command.name == "/help") {
+        command.type = CommandType::HELP;
+    } else if (command.name == "/latency") {
+        command.type = CommandType::LATENCY;
+    } else if (command.name == "/stats") {
+        command.type = CommandType::STATS;
+    } else if (command.name == "/trace" && count <= 1) {
+        command.type = CommandType::TRACE;
+    }
+
+    return command;
+}
+
+CommandQueue::CommandQueue()
+: first(0), count(0), arena_head(0), arena_tail(0), high_water(0) {}
+
+bool CommandQueue::reserve(size_t length, size_t& offset) {
+    if (count == 0) arena_head = arena_tail = 0;
+    else if (arena_head == arena_tail) return false; // Arena is full
+
+    if (arena_tail >= arena_head) {
+        // Free space is at the end and, after wrapping, before the head
+        if (ARENA_SIZE - arena_tail >= length) {
+            offset = arena_tail;
+        } else if (arena_head >= length) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (arena_head - arena_tail >= length) {
+        offset = arena_tail;
+    } else {
+        return false;
+    }
+
+    arena_tail = offset + length;
+    return true;
+}
+
+bool CommandQueue::push(const Command& command) {
+    if (count == CAPACITY) return false;
+
+    size_t offset;
+    std::string_view text = command.text;
+    size_t length = std::max<size_t>(text.size(), 1); // Empty lines take a byte too, so that full and empty arena differ
+    if (!reserve(length, offset)) return false;
+
+    memcpy(arena + offset, text.data(), text.size());
+
+    // Same command, views moved into the copy
+    Entry& entry = entries[(first + count) % CAPACITY];
+    entry.offset = offset;
+    entry.length = length;
+    entry.command.type = command.type;
+
+    auto rebase = [&](std::string_view view) {
+        if (view.empty()) return std::string_view();
+        return std::string_view(arena + offset + (view.data() - text.data()), view.size());
+    };
+    entry.command.text = std::string_view(arena + offset, text.size());
+    entry.command.name = rebase(command.name);
+    for (size_t i = 0; i < 3; i++) entry.command.params[i] = rebase(command.params[i]);
+
+    count++;
+    high_water = std::max(high_water, count);
+
+    return true;
+}
+
+const Command& CommandQueue::front() const {
+    return entries[first].command;
+}
+
+void CommandQueue::pop() {
+    const Entry& entry = entries[first];
+    arena_head = entry.offset + entry.length;
+
+    first = (first + 1) % CAPACITY;
+    count--;
+}
+
+bool CommandQueue::empty() const {
+    return count == 0;
+}
+
+size_t CommandQueue::size() const {
+    return count;
+}
+
+size_t CommandQueue::highWater() const {
+    return high_water;
+}
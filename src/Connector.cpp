@@ -0,0 +1,272 @@
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include "Connector.h"
+
+// Results of both lookups, index 0 is IPv6 and 1 is IPv4
+struct Connector::Lookup {
+    std::mutex mutex;
+    int event_fd = -1; // Readable when a lookup finished, polled together with the connecting sockets
+    std::vector<Endpoint> addresses[2];
+    int status[2] = {0, 0}; // getaddrinfo() result
+    bool finished[2] = {false, false};
+
+    ~Lookup() {
+        if (event_fd != -1) close(event_fd);
+    }
+};
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+}
+
+std::string addressString(const struct sockaddr_storage& addr) {
+    char text[INET6_ADDRSTRLEN] = "?";
+
+    if (addr.ss_family == AF_INET6) {
+        const auto& in6 = reinterpret_cast<const struct sockaddr_in6&>(addr);
+        inet_ntop(AF_INET6, &in6.sin6_addr, text, sizeof(text));
+        return "[" + std::string(text) + "]:" + std::to_string(ntohs(in6.sin6_port));
+    }
+
+    const auto& in = reinterpret_cast<const struct sockaddr_in&>(addr);
+    inet_ntop(AF_INET, &in.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(ntohs(in.sin_port));
+}
+
+Connector::Connector(const std::string& host, unsigned short port, std::chrono::milliseconds timeout)
+: lookup(std::make_shared<Lookup>()), deadline(Clock::now() + timeout), taken{0, 0}, next_family(0),
+  finished{false, false}, status{0, 0}, resolved_at{Clock::time_point::max(), Clock::time_point::max()} {
+    lookup->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (lookup->event_fd == -1) {
+        failure = std::string("eventfd: ") + strerror(errno);
+        return;
+    }
+
+    // A lookup stuck in the resolver is left behind after the deadline, it only holds the shared results
+    for (int index = 0; index < 2; index++) {
+        try {
+            std::thread(lookUp, lookup, host, std::to_string(port), index).detach();
+        } catch (const std::system_error&) {
+            lookUp(lookup, host, std::to_string(port), index); // No threads, look up in place
+        }
+    }
+}
+
+Connector::~Connector() = default;
+
+void Connector::lookUp(std::shared_ptr<Lookup> lookup, std::string host, std::string port, int index) {
+    struct addrinfo hints = {}, *addrs;
+    hints.ai_family = index == 0 ? AF_INET6 : AF_INET;
+    hints.ai_socktype = SOCK_STREAM; // One entry per address, used for UDP as well
+
+    std::vector<Endpoint> found;
+    int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs);
+    if (status == 0) {
+        for (struct addrinfo* addr = addrs; addr != nullptr; addr = addr->ai_next) {
+            Endpoint endpoint = {};
+            memcpy(&endpoint.addr, addr->ai_addr, addr->ai_addrlen);
+            endpoint.length = addr->ai_addrlen;
+            found.push_back(endpoint);
+        }
+        freeaddrinfo(addrs);
+    }
+
+    std::lock_guard<std::mutex> guard(lookup->mutex);
+    lookup->addresses[index] = std::move(found);
+    lookup->status[index] = status;
+    lookup->finished[index] = true;
+
+    uint64_t one = 1;
+    if (write(lookup->event_fd, &one, sizeof(one)) < 0) {} // Only wakes up the waiting poll()
+}
+
+const std::string& Connector::error() const {
+    return failure;
+}
+
+Endpoint Connector::mapped(const Endpoint& endpoint) {
+    if (endpoint.addr.ss_family != AF_INET) return endpoint;
+
+    const auto& in = reinterpret_cast<const struct sockaddr_in&>(endpoint.addr);
+    Endpoint result = {};
+    auto& in6 = reinterpret_cast<struct sockaddr_in6&>(result.addr);
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = in.sin_port;
+    in6.sin6_addr.s6_addr[10] = 0xFF; // ::ffff:a.b.c.d
+    in6.sin6_addr.s6_addr[11] = 0xFF;
+    memcpy(&in6.sin6_addr.s6_addr[12], &in.sin_addr, sizeof(in.sin_addr));
+    result.length = sizeof(in6);
+    return result;
+}
+
+bool Connector::collect() {
+    uint64_t count;
+    if (read(lookup->event_fd, &count, sizeof(count)) < 0) {} // Drained, collected below
+
+    std::lock_guard<std::mutex> guard(lookup->mutex);
+    for (int index = 0; index < 2; index++) {
+        if (!lookup->finished[index] || finished[index]) continue;
+
+        finished[index] = true;
+        resolved_at[index] = Clock::now();
+        status[index] = lookup->status[index];
+        const std::vector<Endpoint>& addresses = lookup->addresses[index];
+        queue[index].insert(queue[index].end(), addresses.begin() + taken[index], addresses.end());
+        taken[index] = addresses.size();
+    }
+
+    return finished[0] && finished[1];
+}
+
+bool Connector::take(Endpoint& endpoint) {
+    if (queue[next_family].empty()) next_family = 1 - next_family;
+    if (queue[next_family].empty()) return false;
+
+    endpoint = queue[next_family].front();
+    queue[next_family].erase(queue[next_family].begin());
+    next_family = 1 - next_family; // Families alternate
+    return true;
+}
+
+int Connector::waitMs(std::chrono::steady_clock::time_point until) const {
+    auto left = std::min(until, deadline) - Clock::now();
+    if (left <= Clock::duration::zero()) return 0;
+    return std::chrono::ceil<std::chrono::milliseconds>(left).count();
+}
+
+std::string Connector::lookupError() const {
+    for (int index : {1, 0}) {
+        if (status[index] != 0 && status[index] != EAI_NONAME && status[index] != EAI_ADDRFAMILY && status[index] != EAI_NODATA)
+            return std::string("getaddrinfo: ") + gai_strerror(status[index]);
+    }
+    if (!finished[0] || !finished[1]) return "name resolution timed out";
+    return "getaddrinfo: " + std::string(gai_strerror(status[1] != 0 ? status[1] : EAI_NONAME));
+}
+
+std::vector<Endpoint> Connector::resolve() {
+    std::vector<Endpoint> endpoints;
+    if (!failure.empty()) return endpoints;
+
+    // Both families are wanted, the slower one only gets RESOLUTION_DELAY once the other has addresses
+    while (!collect() && Clock::now() < deadline) {
+        auto first = std::min(resolved_at[0], resolved_at[1]);
+        bool any = !queue[0].empty() || !queue[1].empty();
+        if (any && Clock::now() >= first + RESOLUTION_DELAY) break;
+
+        struct pollfd event = {lookup->event_fd, POLLIN, 0};
+        poll(&event, 1, waitMs(any ? first + RESOLUTION_DELAY : deadline));
+    }
+
+    Endpoint endpoint;
+    while (take(endpoint)) endpoints.push_back(endpoint);
+
+    if (endpoints.empty()) failure = lookupError();
+    return endpoints;
+}
+
+int Connector::connect() {
+    if (!failure.empty()) return -1;
+
+    struct Attempt {
+        int fd;
+        Endpoint endpoint;
+    };
+    std::vector<Attempt> attempts;
+    std::vector<struct pollfd> events;
+    auto next_attempt = Clock::now();
+    int winner = -1;
+    std::string last_error;
+
+    while (winner == -1) {
+        bool resolved = collect();
+        auto now = Clock::now();
+        if (now >= deadline) {
+            last_error = attempts.empty() && queue[0].empty() && queue[1].empty() ? lookupError() : "connection timed out";
+            break;
+        }
+
+        // IPv6 is preferred, after IPv4 arrived first it still gets RESOLUTION_DELAY
+        bool started = finished[0] || (finished[1] && now >= resolved_at[1] + RESOLUTION_DELAY);
+
+        // Next attempt starts after ATTEMPT_DELAY, or right away when nothing is in progress
+        while (started && (attempts.empty() || now >= next_attempt)) {
+            Endpoint endpoint;
+            if (!take(endpoint)) break;
+
+            int fd = socket(endpoint.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (fd == -1) {
+                last_error = addressString(endpoint.addr) + ": socket: " + strerror(errno);
+                continue;
+            }
+
+            if (::connect(fd, reinterpret_cast<const struct sockaddr*>(&endpoint.addr), endpoint.length) == 0) {
+                winner = fd;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                last_error = addressString(endpoint.addr) + ": " + strerror(errno);
+                close(fd);
+                continue;
+            }
+
+            attempts.push_back({fd, endpoint});
+            next_attempt = now + ATTEMPT_DELAY;
+        }
+        if (winner != -1) break;
+
+        if (resolved && attempts.empty() && queue[0].empty() && queue[1].empty()) {
+            if (last_error.empty()) last_error = lookupError();
+            break;
+        }
+
+        // Waits for a connection, a lookup, the next attempt or the deadline
+        auto until = deadline;
+        if (!started && finished[1]) until = resolved_at[1] + RESOLUTION_DELAY;
+        else if (!attempts.empty() && (!queue[0].empty() || !queue[1].empty())) until = next_attempt;
+
+        events.assign(1, {lookup->event_fd, POLLIN, 0});
+        for (const Attempt& attempt : attempts) events.push_back({attempt.fd, POLLOUT, 0});
+        if (poll(events.data(), events.size(), waitMs(until)) <= 0) continue;
+
+        for (size_t i = attempts.size(); i-- > 0;) {
+            if (events[i + 1].revents == 0) continue;
+
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error == 0 && winner == -1) {
+                winner = attempts[i].fd;
+                attempts.erase(attempts.begin() + i);
+                continue;
+            }
+            if (error == 0) continue; // Another one already won, closed below
+
+            last_error = addressString(attempts[i].endpoint.addr) + ": " + strerror(error);
+            close(attempts[i].fd);
+            attempts.erase(attempts.begin() + i);
+            next_attempt = Clock::now(); // A refused attempt doesn't delay the next one
+        }
+    }
+
+    for (const Attempt& attempt : attempts) close(attempt.fd);
+
+    if (winner == -1) {
+        failure = last_error;
+        return -1;
+    }
+
+    // The session sends with blocking calls
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+    return winner;
+}
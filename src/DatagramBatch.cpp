@@ -0,0 +1,115 @@
+#include <cstring>
+#include <cerrno>
+
+#include "DatagramBatch.h"
+
+DatagramBatch::DatagramBatch(size_t size)
+: batch_size(size == 0 ? 1 : size), socket_fd(-1),
+  recv_data(batch_size * RECV_SLOT_SIZE), recv_addr(batch_size), recv_iov(batch_size), recv_msgs(batch_size),
+  send_data(SEND_ARENA_SIZE), send_used(0), send_iov(batch_size), send_msgs(batch_size), send_count(0) {
+    for (size_t i = 0; i < batch_size; i++) {
+        recv_iov[i].iov_base = recv_data.data() + i * RECV_SLOT_SIZE;
+        recv_iov[i].iov_len = RECV_SLOT_SIZE;
+    }
+}
+
+size_t DatagramBatch::batchSize() const {
+    return batch_size;
+}
+
+bool DatagramBatch::start(int fd) {
+    socket_fd = fd;
+    return true;
+}
+
+int DatagramBatch::pollFd() const {
+    return socket_fd; // Socket itself tells when datagrams are waiting
+}
+
+int DatagramBatch::receive(int fd) {
+    for (size_t i = 0; i < batch_size; i++) {
+        memset(&recv_msgs[i].msg_hdr, 0, sizeof(recv_msgs[i].msg_hdr));
+        recv_msgs[i].msg_hdr.msg_name = &recv_addr[i];
+        recv_msgs[i].msg_hdr.msg_namelen = sizeof(recv_addr[i]);
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Takes whatever is already waiting, the event loop saw at least one datagram
+    int count = recvmmsg(fd, recv_msgs.data(), batch_size, MSG_DONTWAIT, nullptr);
+    if (count > 0) {
+        counters.recv_calls++;
+        counters.recv_datagrams += count;
+    }
+    return count;
+}
+
+std::span<const uint8_t> DatagramBatch::datagram(int index) const {
+    return std::span<const uint8_t>(recv_data.data() + index * RECV_SLOT_SIZE, recv_msgs[index].msg_len);
+}
+
+const struct sockaddr_storage& DatagramBatch::sender(int index) const {
+    return recv_addr[index];
+}
+
+bool DatagramBatch::truncated(int index) const {
+    return recv_msgs[index].msg_hdr.msg_flags & MSG_TRUNC;
+}
+
+bool DatagramBatch::queue(std::span<const std::byte> data) {
+    if (send_count == batch_size || data.size() > SEND_ARENA_SIZE - send_used) return false;
+
+    std::byte* copy = send_data.data() + send_used;
+    memcpy(copy, data.data(), data.size());
+    send_used += data.size();
+
+    send_iov[send_count].iov_base = copy;
+    send_iov[send_count].iov_len = data.size();
+    send_count++;
+
+    return true;
+}
+
+bool DatagramBatch::pending() const {
+    return send_count != 0;
+}
+
+bool DatagramBatch::flush(int fd, const struct sockaddr_storage& dest) {
+    size_t sent = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < send_count; i++) {
+        memset(&send_msgs[i].msg_hdr, 0, sizeof(send_msgs[i].msg_hdr));
+        send_msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr_storage*>(&dest);
+        send_msgs[i].msg_hdr.msg_namelen = addressLength(dest);
+        send_msgs[i].msg_hdr.msg_iov = &send_iov[i];
+        send_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // sendmmsg() may stop early, send the rest until it fails
+    while (sent < send_count) {
+        int count = sendmmsg(fd, send_msgs.data() + sent, send_count - sent, 0);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) continue;
+            if (count == 0) errno = EAGAIN; // Nothing sent and no error, the socket buffer is full
+            ok = false;
+            break;
+        }
+        counters.send_calls++;
+        counters.send_datagrams += count;
+        sent += count;
+    }
+
+    send_count = 0;
+    send_used = 0;
+
+    return ok;
+}
+
+const DatagramBatch::Stats& DatagramBatch::stats() const {
+    return counters;
+}
+
+const char* DatagramBatch::name() const {
+    return "recvmmsg/sendmmsg";
+}
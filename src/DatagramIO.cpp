@@ -0,0 +1,21 @@
+#include <cerrno>
+
+#include "DatagramIO.h"
+#include "DatagramBatch.h"
+#include "UringDatagramIO.h"
+
+std::unique_ptr<DatagramIO> DatagramIO::create(const std::string& backend, size_t batch_size, int fd) {
+    if (backend == "uring") {
+        auto uring = std::make_unique<UringDatagramIO>(batch_size);
+        if (uring->valid() && uring->start(fd)) return uring;
+
+        int error = errno; // Tearing the ring down must not hide why it failed
+        uring.reset();
+        errno = error;
+        return nullptr;
+    }
+
+    auto batch = std::make_unique<DatagramBatch>(batch_size);
+    batch->start(fd);
+    return batch;
+}
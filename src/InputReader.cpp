@@ -0,0 +1,77 @@
+#include <unistd.h>
+#include <cstring>
+
+#include "InputReader.h"
+
+InputReader::InputReader()
+: start(0), end(0), scan(0), last_start(0), at_eof(false), discarding(false), overlong(0) {}
+
+ssize_t InputReader::readFrom(int fd) {
+    // Move the unfinished line to the front to make room
+    if (start != 0) {
+        memmove(buffer, buffer + start, end - start);
+        end -= start;
+        scan -= start;
+        start = 0;
+    }
+
+    // Line fills the whole buffer, drop it and skip to its end
+    if (end == CAPACITY) {
+        end = scan = 0;
+        discarding = true;
+        overlong++;
+    }
+
+    ssize_t bytes = read(fd, buffer + end, CAPACITY - end);
+    if (bytes > 0) end += bytes;
+    else if (bytes == 0) at_eof = true;
+
+    return bytes;
+}
+
+bool InputReader::nextLine(std::string_view& line) {
+    while (scan < end) {
+        const void* newline = memchr(buffer + scan, '\n', end - scan);
+        if (newline == nullptr) {
+            scan = end;
+            break;
+        }
+
+        size_t position = static_cast<const char*>(newline) - buffer;
+        line = std::string_view(buffer + start, position - start);
+        last_start = start;
+        start = scan = position + 1;
+
+        if (discarding) {
+            discarding = false; // Tail of an overlong line
+            continue;
+        }
+        return true;
+    }
+
+    // Last line may be missing its '\n'
+    if (at_eof && start < end) {
+        line = std::string_view(buffer + start, end - start);
+        last_start = start;
+        start = scan = end;
+        if (discarding) {
+            discarding = false;
+            return false;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void InputReader::unreadLine() {
+    start = scan = last_start;
+}
+
+bool InputReader::eof() const {
+    return at_eof;
+}
+
+size_t InputReader::dropped() const {
+    return overlong;
+}
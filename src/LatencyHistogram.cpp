@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t value) {
+    constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    if (value < SUB_COUNT) return value; // Small values have a bucket each
+
+    // Position of the highest bit selects the power of two, the next SUB_BITS bits the bucket in it
+    unsigned exponent = std::bit_width(value) - 1;
+    uint64_t mantissa = value >> (exponent - SUB_BITS);
+    return ((exponent - SUB_BITS + 1) << SUB_BITS) + (mantissa - SUB_COUNT);
+}
+
+uint64_t LatencyHistogram::upperEdge(size_t bucket) {
+    constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    if (bucket < SUB_COUNT) return bucket;
+
+    unsigned shift = (bucket >> SUB_BITS) - 1;
+    uint64_t mantissa = (bucket & (SUB_COUNT - 1)) + SUB_COUNT;
+    return (mantissa << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration) {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    uint64_t value = ns > 0 ? ns : 0;
+
+    buckets[bucketOf(value)]++;
+    samples++;
+    maximum = std::max(maximum, value);
+}
+
+void LatencyHistogram::reset() {
+    buckets.fill(0);
+    samples = 0;
+    maximum = 0;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return samples;
+}
+
+std::chrono::nanoseconds LatencyHistogram::max() const {
+    return std::chrono::nanoseconds(maximum);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double percent) const {
+    if (samples == 0) return std::chrono::nanoseconds(0);
+
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(percent / 100 * samples));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) return std::chrono::nanoseconds(std::min(upperEdge(bucket), maximum));
+    }
+    return max();
+}
+
+void LatencyHistogram::print(OutputBuffer& out, std::string_view name) const {
+    auto us = [](std::chrono::nanoseconds value) { return value.count() / 1000.0; };
+
+    out << name << " latency (us): samples " << samples
+        << " p50 " << us(percentile(50)) << " p99 " << us(percentile(99))
+        << " p99.9 " << us(percentile(99.9)) << " max " << us(max()) << '\n';
+}
@@ -0,0 +1,76 @@
+#include <cstring>
+
+#include "LineFramer.h"
+
+LineFramer::LineFramer() : head(0), tail(0), scan(0) {}
+
+char* LineFramer::writePtr() {
+    return ring + (tail & MASK);
+}
+
+size_t LineFramer::writable() const {
+    size_t free_space = CAPACITY - (tail - head);
+    size_t until_end = CAPACITY - (tail & MASK);
+    return free_space < until_end ? free_space : until_end;
+}
+
+void LineFramer::commit(size_t bytes) {
+    tail += bytes;
+}
+
+size_t LineFramer::findNewline(size_t from) const {
+    while (from < tail) {
+        size_t offset = from & MASK;
+        size_t chunk = tail - from;
+        if (chunk > CAPACITY - offset) chunk = CAPACITY - offset; // Stop at the end of the ring
+
+        const void* hit = memchr(ring + offset, '\n', chunk);
+        if (hit != nullptr) return from + (static_cast<const char*>(hit) - (ring + offset));
+
+        from += chunk;
+    }
+    return tail;
+}
+
+bool LineFramer::nextFrame(std::string_view& frame) {
+    while (true) {
+        size_t newline = findNewline(scan);
+        if (newline == tail) {
+            scan = tail;
+            if (head == tail) reset(); // Empty, give the next recv() the whole ring
+            return false;
+        }
+
+        scan = newline + 1;
+
+        // Only CRLF terminates a frame, a lone LF is kept as part of the content
+        if (newline == head || ring[(newline - 1) & MASK] != '\r') continue;
+
+        size_t start = head;
+        size_t length = newline - 1 - start;
+        head = scan;
+
+        size_t offset = start & MASK;
+        if (offset + length <= CAPACITY) {
+            frame = std::string_view(ring + offset, length);
+        } else {
+            size_t first = CAPACITY - offset;
+            memcpy(linear, ring + offset, first);
+            memcpy(linear + first, ring, length - first);
+            frame = std::string_view(linear, length);
+        }
+        return true;
+    }
+}
+
+bool LineFramer::overflow() const {
+    return tail - head == CAPACITY;
+}
+
+size_t LineFramer::buffered() const {
+    return tail - head;
+}
+
+void LineFramer::reset() {
+    head = tail = scan = 0;
+}
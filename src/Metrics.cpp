@@ -0,0 +1,82 @@
+#include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "Metrics.h"
+
+namespace {
+    // Appends to a fixed buffer, drops what doesn't fit
+    struct LineWriter {
+        char* out;
+        size_t size;
+        size_t length = 0;
+
+        void put(const char* text) {
+            size_t n = std::min(strlen(text), size - length);
+            memcpy(out + length, text, n);
+            length += n;
+        }
+
+        template<typename T>
+        void pair(const char* key, T value) {
+            if (length != 0) put(" ");
+            put(key);
+            put("=");
+            auto result = std::to_chars(out + length, out + size, value);
+            if (result.ec == std::errc()) length = result.ptr - out;
+        }
+    };
+}
+
+Metrics::Metrics() : started(std::chrono::steady_clock::now()) {}
+
+size_t Metrics::format(char* out, size_t size) const {
+    LineWriter w{out, size};
+    auto uptime = std::chrono::steady_clock::now() - started; // clock_gettime() is async-signal-safe
+
+    w.pair("uptime_ms", std::chrono::duration_cast<std::chrono::milliseconds>(uptime).count());
+    w.pair("messages_sent", messages_sent.get());
+    w.pair("messages_received", messages_received.get());
+    w.pair("confirms_sent", confirms_sent.get());
+    w.pair("confirms_received", confirms_received.get());
+    w.pair("bytes_sent", bytes_sent.get());
+    w.pair("bytes_received", bytes_received.get());
+    w.pair("retransmissions", retransmissions.get());
+    w.pair("messages_confirmed", messages_confirmed.get());
+    w.pair("confirm_timeouts", confirm_timeouts.get());
+    w.pair("send_errors", send_errors.get());
+    w.pair("replies_refused", replies_refused.get());
+    w.pair("unknown_messages", unknown_messages.get());
+    w.pair("duplicates", duplicates.get());
+    w.pair("unexpected_confirms", unexpected_confirms.get());
+    w.pair("reconnects", reconnects.get());
+    w.pair("command_queue", command_queue.get());
+    w.pair("command_queue_high_water", command_queue_high_water.get());
+    w.pair("window_in_flight", window_in_flight.get());
+    w.pair("rto_us", rto_us.get());
+    w.pair("srtt_us", srtt_us.get());
+    w.pair("udp_recv_calls", udp_recv_calls.get());
+    w.pair("udp_recv_datagrams", udp_recv_datagrams.get());
+    w.pair("udp_send_calls", udp_send_calls.get());
+    w.pair("udp_send_datagrams", udp_send_datagrams.get());
+    w.pair("auth_wait_us", auth_wait_us.get());
+    w.pair("recovery_us", recovery_us.get());
+    w.pair("transcript_written", transcript_written.get());
+    w.pair("transcript_dropped", transcript_dropped.get());
+
+    return w.length;
+}
+
+void Metrics::dump(int fd) const {
+    char line[LINE_SIZE];
+    size_t length = format(line, sizeof(line) - 1);
+    line[length++] = '\n';
+
+    size_t written = 0;
+    while (written < length) {
+        ssize_t bytes = write(fd, line + written, length - written);
+        if (bytes <= 0) return;
+        written += bytes;
+    }
+}
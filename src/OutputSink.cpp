@@ -0,0 +1,93 @@
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "OutputSink.h"
+
+OutputBuffer::OutputBuffer(int fd) : fd(fd), other(nullptr) {
+    data.reserve(OutputSink::FLUSH_SIZE * 2);
+}
+
+OutputBuffer& OutputBuffer::operator<<(std::string_view text) {
+    if (fd == -1) return *this;
+    if (other != nullptr && !other->data.empty()) other->write(); // Keeps stdout and stderr lines in order
+    if (data.empty()) oldest = std::chrono::steady_clock::now();
+    data.insert(data.end(), text.begin(), text.end());
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* text) {
+    return *this << std::string_view(text);
+}
+
+OutputBuffer& OutputBuffer::operator<<(char c) {
+    return *this << std::string_view(&c, 1);
+}
+
+OutputBuffer& OutputBuffer::operator<<(bool value) {
+    return *this << (value ? '1' : '0');
+}
+
+OutputBuffer& OutputBuffer::operator<<(double value) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, 2);
+    return *this << std::string_view(digits, result.ptr - digits);
+}
+
+size_t OutputBuffer::size() const {
+    return data.size();
+}
+
+bool OutputBuffer::write() {
+    size_t written = 0;
+    bool ok = true;
+
+    while (written < data.size()) {
+        ssize_t bytes = ::write(fd, data.data() + written, data.size() - written);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            ok = false; // Reader is gone, nothing else can be done with the text
+            break;
+        }
+        written += bytes;
+    }
+
+    data.clear();
+    return ok;
+}
+
+OutputSink::OutputSink() : out(STDOUT_FILENO), err(STDERR_FILENO) {
+    out.other = &err;
+    err.other = &out;
+}
+
+OutputSink::~OutputSink() {
+    flush();
+}
+
+void OutputSink::flush() {
+    if (out.size() != 0) out.write();
+    if (err.size() != 0) err.write();
+}
+
+void OutputSink::flushIfDue() {
+    if (out.size() >= FLUSH_SIZE || err.size() >= FLUSH_SIZE) {
+        flush();
+        return;
+    }
+
+    if (out.size() == 0 && err.size() == 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if ((out.size() != 0 && now - out.oldest >= FLUSH_DELAY) || (err.size() != 0 && now - err.oldest >= FLUSH_DELAY)) {
+        flush();
+    }
+}
+
+void OutputSink::mute() {
+    flush();
+    for (OutputBuffer* buffer : {&out, &err}) {
+        buffer->fd = -1;
+        buffer->data.shrink_to_fit();
+    }
+}
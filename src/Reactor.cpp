@@ -0,0 +1,170 @@
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/eventfd.h>
+
+#include "Reactor.h"
+
+Reactor::Reactor()
+: epoll_fd(epoll_create1(EPOLL_CLOEXEC)), stop_fd(-1), attached(0), stopping(false), events(256) {
+    if (epoll_fd == -1) {
+        std::cerr << "ERR: epoll_create1: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // Never read, once written it stays readable and every later epoll_wait() returns at once
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event) == -1) {
+        std::cerr << "ERR: eventfd: " << strerror(errno) << std::endl;
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+Reactor::~Reactor() {
+    if (epoll_fd != -1) close(epoll_fd);
+    if (stop_fd != -1) close(stop_fd);
+}
+
+bool Reactor::valid() const {
+    return epoll_fd != -1;
+}
+
+bool Reactor::add(int fd, uint32_t interest, EventHandler* handler) {
+    struct epoll_event event = {};
+    event.events = interest;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) return false;
+
+    if (handlers.size() <= static_cast<size_t>(fd)) handlers.resize(fd + 1, nullptr);
+    handlers[fd] = handler;
+
+    return true;
+}
+
+bool Reactor::modify(int fd, uint32_t interest) {
+    struct epoll_event event = {};
+    event.events = interest;
+    event.data.fd = fd;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void Reactor::remove(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    if (static_cast<size_t>(fd) < handlers.size()) handlers[fd] = nullptr;
+}
+
+void Reactor::attach(EventHandler* handler) {
+    attached++;
+    schedule(handler);
+}
+
+void Reactor::detach(EventHandler* handler) {
+    if (attached > 0) attached--;
+
+    // The handler may be deleted right after, nothing may point to it anymore
+    ready.erase(std::remove(ready.begin(), ready.end(), handler), ready.end());
+    std::replace(dispatching.begin(), dispatching.end(), handler, static_cast<EventHandler*>(nullptr));
+    wakeAt(handler, std::chrono::steady_clock::time_point::max());
+    handler->pending = false;
+}
+
+void Reactor::schedule(EventHandler* handler) {
+    markReady(handler);
+}
+
+void Reactor::wakeAt(EventHandler* handler, std::chrono::steady_clock::time_point deadline) {
+    auto it = std::find_if(wakeups.begin(), wakeups.end(), [handler](const auto& wakeup) { return wakeup.first == handler; });
+
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        if (it != wakeups.end()) wakeups.erase(it);
+    } else if (it != wakeups.end()) {
+        it->second = deadline;
+    } else {
+        wakeups.emplace_back(handler, deadline);
+    }
+}
+
+int Reactor::waitMs() const {
+    if (!ready.empty()) return 0; // Some handler has work of its own
+    if (wakeups.empty()) return -1;
+
+    auto earliest = std::min_element(wakeups.begin(), wakeups.end(),
+                                     [](const auto& a, const auto& b) { return a.second < b.second; })->second;
+    auto left = earliest - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero()) return 0;
+
+    // Rounded up, waking up early would only spin
+    return std::chrono::ceil<std::chrono::milliseconds>(left).count();
+}
+
+void Reactor::wakeDue() {
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < wakeups.size();) {
+        if (wakeups[i].second > now) {
+            i++;
+            continue;
+        }
+        markReady(wakeups[i].first);
+        wakeups[i] = wakeups.back();
+        wakeups.pop_back();
+    }
+}
+
+void Reactor::markReady(EventHandler* handler) {
+    if (handler->pending) return;
+    handler->pending = true;
+    ready.push_back(handler);
+}
+
+bool Reactor::run() {
+    while (attached > 0 && !stopping) {
+        // Handlers first get a chance to flush their output and rearm timers,
+        // the ones scheduled meanwhile land in ready again
+        dispatching.swap(ready);
+        for (EventHandler* handler : dispatching) {
+            if (handler == nullptr) continue; // Detached by an earlier handler of this iteration
+            handler->pending = false;
+            handler->afterEvents();
+        }
+        dispatching.clear();
+
+        if (attached == 0 || stopping) break;
+
+        int count = epoll_wait(epoll_fd, events.data(), events.size(), waitMs());
+        if (count == -1) {
+            if (errno == EINTR) continue; // stop() is checked by the loop condition
+            std::cerr << "ERR: epoll_wait: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            EventHandler* handler = static_cast<size_t>(fd) < handlers.size() ? handlers[fd] : nullptr;
+            if (handler == nullptr) continue; // Removed by an earlier event of this batch, or stop_fd
+
+            handler->onEvent(fd, events[i].events);
+            markReady(handler);
+        }
+
+        if (!wakeups.empty()) wakeDue();
+    }
+
+    return true;
+}
+
+void Reactor::stop() {
+    stopping = true;
+
+    // The interrupted code may be about to check errno of its own failed call
+    int saved_errno = errno;
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof one) == -1) {} // Counter can't overflow by ones, EAGAIN never happens
+    errno = saved_errno;
+}
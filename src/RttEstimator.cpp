@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "RttEstimator.h"
+
+RttEstimator::RttEstimator(std::chrono::milliseconds initial)
+: smoothed(0), variation(0), current(std::clamp<Duration>(initial, MIN_RTO, MAX_RTO)),
+  measured(false), jitter(std::random_device{}()) {}
+
+void RttEstimator::sample(std::chrono::steady_clock::duration rtt) {
+    Duration r = std::chrono::duration_cast<Duration>(rtt);
+    if (r.count() < 0) return;
+
+    if (!measured) {
+        smoothed = r;
+        variation = r / 2;
+        measured = true;
+    } else {
+        Duration delta = smoothed > r ? smoothed - r : r - smoothed;
+        variation = (variation * 3 + delta) / 4;
+        smoothed = (smoothed * 7 + r) / 8;
+    }
+
+    current = std::clamp<Duration>(smoothed + variation * 4, MIN_RTO, MAX_RTO);
+}
+
+RttEstimator::Duration RttEstimator::timeout(int retry_count) {
+    Duration value = current;
+    for (int i = 0; i < retry_count && value < MAX_RTO; i++) value *= 2;
+    value = std::min(value, MAX_RTO);
+
+    // Spread retransmissions of many messages (and many clients) over time
+    if (retry_count > 0) {
+        value += Duration(std::uniform_int_distribution<Duration::rep>(0, value.count() / 4)(jitter));
+    }
+
+    return value;
+}
+
+RttEstimator::Duration RttEstimator::rto() const {
+    return current;
+}
+
+RttEstimator::Duration RttEstimator::srtt() const {
+    return smoothed;
+}
+
+RttEstimator::Duration RttEstimator::rttvar() const {
+    return variation;
+}
+
+bool RttEstimator::hasSample() const {
+    return measured;
+}
@@ -0,0 +1,79 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "ScriptFile.h"
+
+ScriptFile::ScriptFile()
+: data(nullptr), length(0), position(0), last_position(0), taken(0) {}
+
+ScriptFile::~ScriptFile() {
+    if (data != nullptr) munmap(const_cast<char*>(data), length);
+}
+
+bool ScriptFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return false;
+    }
+
+    // Empty script has nothing to map, mmap() would refuse zero length
+    length = st.st_size;
+    if (length != 0) {
+        // Not populated up front, pages are read in as lines are taken, read-ahead keeps in front of us
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            length = 0;
+            return false;
+        }
+        madvise(mapped, length, MADV_SEQUENTIAL); // Pages behind us can be dropped
+        data = static_cast<const char*>(mapped);
+    }
+
+    close(fd); // The mapping keeps the file
+    return true;
+}
+
+bool ScriptFile::nextLine(std::string_view& line) {
+    if (position >= length) return false;
+
+    const void* newline = memchr(data + position, '\n', length - position);
+    size_t end = newline != nullptr ? static_cast<const char*>(newline) - data : length;
+
+    line = std::string_view(data + position, end - position);
+
+    last_position = position;
+    position = newline != nullptr ? end + 1 : length;
+    taken++;
+
+    return true;
+}
+
+void ScriptFile::unreadLine() {
+    position = last_position;
+    taken--;
+}
+
+bool ScriptFile::eof() const {
+    return position >= length;
+}
+
+size_t ScriptFile::lines() const {
+    return taken;
+}
+
+size_t ScriptFile::size() const {
+    return length;
+}
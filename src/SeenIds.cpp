@@ -0,0 +1,66 @@
+#include <cstring>
+
+#include "SeenIds.h"
+
+SeenIds::SeenIds() {
+    clear();
+}
+
+void SeenIds::clear() {
+    memset(bits, 0, sizeof(bits));
+    newest = 0;
+    started = false;
+}
+
+bool SeenIds::test(uint16_t id) const {
+    return bits[id >> 6] & (uint64_t(1) << (id & 63));
+}
+
+void SeenIds::set(uint16_t id) {
+    bits[id >> 6] |= uint64_t(1) << (id & 63);
+}
+
+void SeenIds::forget(uint16_t from, uint16_t count) {
+    // Bit by bit up to a word boundary, then whole words
+    while (count != 0 && (from & 63) != 0) {
+        bits[from >> 6] &= ~(uint64_t(1) << (from & 63));
+        from++;
+        count--;
+    }
+    while (count >= 64) {
+        bits[from >> 6] = 0;
+        from += 64;
+        count -= 64;
+    }
+    while (count != 0) {
+        bits[from >> 6] &= ~(uint64_t(1) << (from & 63));
+        from++;
+        count--;
+    }
+}
+
+bool SeenIds::insert(uint16_t message_id) {
+    if (!started) {
+        started = true;
+        newest = message_id;
+        set(message_id);
+        return true;
+    }
+
+    uint16_t ahead = message_id - newest;
+    if (ahead != 0 && ahead < HALF) {
+        // Window slides forward, IDs that fall behind it are forgotten.
+        // Each ID is cleared once per pass through the ID space, so this is O(1) amortized.
+        forget(static_cast<uint16_t>(newest - HALF + 1), ahead);
+        newest = message_id;
+        set(message_id);
+        return true;
+    }
+
+    if (ahead == HALF) return true; // Just outside the window, too old to tell
+
+    if (test(message_id)) return false;
+
+    set(message_id);
+    return true;
+}
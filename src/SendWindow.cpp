@@ -0,0 +1,73 @@
+#include "SendWindow.h"
+
+SendWindow::SendWindow(uint16_t size)
+: mask(0), window(size), base(0), next(0), in_flight(0) {
+    if (window == 0) window = 1;
+    if (window > MAX_SIZE) window = MAX_SIZE;
+
+    size_t capacity = 1;
+    while (capacity < window) capacity <<= 1;
+
+    slots.resize(capacity);
+    mask = static_cast<uint16_t>(capacity - 1);
+}
+
+uint16_t SendWindow::size() const {
+    return window;
+}
+
+size_t SendWindow::inFlight() const {
+    return in_flight;
+}
+
+bool SendWindow::empty() const {
+    return in_flight == 0;
+}
+
+bool SendWindow::full() const {
+    return in_flight != 0 && static_cast<uint16_t>(next - base) >= window;
+}
+
+bool SendWindow::push(uint16_t message_id, std::span<const std::byte> data, std::chrono::steady_clock::time_point now,
+                      std::chrono::steady_clock::time_point deadline) {
+    if (empty()) {
+        base = next = message_id;
+    } else if (full() || message_id != next) {
+        return false;
+    }
+
+    Slot& slot = slots[message_id & mask];
+    slot.used = true;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    slot.message.message_data.assign(bytes, bytes + data.size()); // Reuses capacity of the slot
+    slot.message.first_send_time = now;
+    slot.message.send_time = now;
+    slot.message.deadline = deadline;
+    slot.message.retry_count = 0;
+
+    next = message_id + 1;
+    in_flight++;
+
+    return true;
+}
+
+TimedMessage* SendWindow::find(uint16_t message_id) {
+    if (empty() || static_cast<uint16_t>(message_id - base) >= static_cast<uint16_t>(next - base)) {
+        return nullptr;
+    }
+
+    Slot& slot = slots[message_id & mask];
+    return slot.used ? &slot.message : nullptr;
+}
+
+bool SendWindow::confirm(uint16_t message_id) {
+    if (find(message_id) == nullptr) return false;
+
+    slots[message_id & mask].used = false;
+    in_flight--;
+
+    // Slide the window past every confirmed message at its start
+    while (base != next && !slots[base & mask].used) base++;
+
+    return true;
+}
@@ -0,0 +1,34 @@
+#include <algorithm>
+
+#include "TimerQueue.h"
+
+// Orders the heap so that the earliest deadline is on top
+static bool later(const TimerQueue::Timer& a, const TimerQueue::Timer& b) {
+    return a.deadline > b.deadline;
+}
+
+void TimerQueue::schedule(Clock::time_point deadline, uint16_t message_id) {
+    heap.push_back(Timer{deadline, message_id});
+    std::push_heap(heap.begin(), heap.end(), later);
+}
+
+bool TimerQueue::empty() const {
+    return heap.empty();
+}
+
+size_t TimerQueue::size() const {
+    return heap.size();
+}
+
+const TimerQueue::Timer& TimerQueue::top() const {
+    return heap.front();
+}
+
+void TimerQueue::pop() {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    heap.pop_back();
+}
+
+void TimerQueue::clear() {
+    heap.clear(); // Keeps capacity, no allocations once warmed up
+}
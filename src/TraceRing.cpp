@@ -0,0 +1,68 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include "TraceRing.h"
+
+namespace {
+    bool writeAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    }
+}
+
+TraceRing::TraceRing() : ring{}, next(0) {}
+
+uint64_t TraceRing::recorded() const {
+    return next;
+}
+
+bool TraceRing::dump(const std::string& path) const {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) return false;
+
+    size_t count = next < CAPACITY ? next : CAPACITY;
+    size_t oldest = (next - count) & (CAPACITY - 1);
+    size_t first_part = std::min(count, CAPACITY - oldest); // Up to the end of the array, the rest wraps around
+
+    TraceHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.records = count;
+    header.recorded = next;
+
+    bool ok = writeAll(fd, &header, sizeof(header))
+           && writeAll(fd, ring.data() + oldest, first_part * sizeof(TraceRecord))
+           && writeAll(fd, ring.data(), (count - first_part) * sizeof(TraceRecord));
+
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return ok;
+}
+
+bool TraceRing::load(const std::string& path, TraceHeader& header, std::vector<TraceRecord>& records) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+        || header.record_size != sizeof(TraceRecord) || header.records > CAPACITY) {
+        return false;
+    }
+
+    records.resize(header.records);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(TraceRecord)));
+}
@@ -0,0 +1,263 @@
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "Transcript.h"
+
+namespace {
+    constexpr size_t LINE_SIZE = 2048; // Longest formatted record
+    constexpr auto BATCH_DELAY = std::chrono::milliseconds(1); // Records gather this long before a write
+
+    const char* typeName(uint8_t type) {
+        switch (type) {
+            case 0x01: return "REPLY";
+            case 0x02: return "AUTH";
+            case 0x03: return "JOIN";
+            case 0x04: return "MSG";
+            case 0xFE: return "ERR";
+            case 0xFF: return "BYE";
+            default:   return "?";
+        }
+    }
+}
+
+Transcript::Transcript(std::string path, uint64_t rotate_size, TranscriptSync sync)
+: path(std::move(path)), rotate_size(rotate_size), sync(sync),
+  ring(std::make_unique<std::array<TranscriptRecord, CAPACITY>>()),
+  head(0), tail(0), dropped_records(0), written_records(0), written_batches(0), write_error(0), stopping(false),
+  sleeping(false), wake_fd(eventfd(0, EFD_CLOEXEC)),
+  batch(std::make_unique<char[]>(BATCH_SIZE)), fd(-1), file_size(0), allocated(0), rotations(0) {}
+
+Transcript::~Transcript() {
+    stop();
+    if (wake_fd != -1) close(wake_fd);
+}
+
+bool Transcript::start() {
+    if (wake_fd == -1 || !openFile()) return false;
+
+    writer = std::thread(&Transcript::run, this);
+    return true;
+}
+
+void Transcript::stop() {
+    if (!writer.joinable()) return;
+
+    stopping.store(true);
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {} // Counter can't overflow, nothing to handle
+    writer.join();
+    closeFile();
+}
+
+bool Transcript::push(bool received, uint8_t type, std::string_view name, std::string_view text) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+        dropped_records.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    TranscriptRecord& r = (*ring)[h & (CAPACITY - 1)];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now); // vDSO, no system call
+    r.time = int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+    r.received = received;
+    r.type = type;
+    r.name_length = std::min(name.size(), TranscriptRecord::NAME_SIZE);
+    r.text_length = std::min(text.size(), TranscriptRecord::TEXT_SIZE);
+    r.truncated = r.name_length != name.size() || r.text_length != text.size();
+    memcpy(r.name, name.data(), r.name_length);
+    memcpy(r.text, text.data(), r.text_length);
+
+    // Sequentially consistent with the writer going to sleep, so either it sees the record or we see it asleep
+    head.store(h + 1);
+    if (sleeping.load() && sleeping.exchange(false)) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {} // Counter can't overflow, nothing to handle
+    }
+    return true;
+}
+
+void Transcript::run() {
+    for (;;) {
+        // While busy the writer naps between batches, push() sees it awake and doesn't signal
+        if (drain() != 0) {
+            std::this_thread::sleep_for(BATCH_DELAY);
+            continue;
+        }
+        if (stopping.load()) break; // Everything pushed before stop() is written
+
+        sleeping.store(true);
+        if (head.load() != tail.load(std::memory_order_relaxed) || stopping.load()) {
+            sleeping.store(false);
+            continue;
+        }
+
+        uint64_t wakeups;
+        if (read(wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EINTR) break;
+        sleeping.store(false);
+    }
+}
+
+size_t Transcript::drain() {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t h = head.load(std::memory_order_acquire);
+    if (t == h) return 0;
+
+    size_t length = 0, records = 0, pending = 0; // pending: formatted, not written yet
+    time_t formatted_second = -1;
+    char second[32] = "";
+
+    for (; t != h; t++) {
+        const TranscriptRecord& r = (*ring)[t & (CAPACITY - 1)];
+
+        // The date is the same for most records of a batch, it is formatted once per second
+        time_t seconds = r.time / 1000000000;
+        if (seconds != formatted_second) {
+            struct tm utc;
+            gmtime_r(&seconds, &utc);
+            strftime(second, sizeof(second), "%Y-%m-%dT%H:%M:%S", &utc);
+            formatted_second = seconds;
+        }
+
+        char* line = batch.get() + length;
+        int n = snprintf(line, LINE_SIZE, "%s.%06ldZ %c %s", second, long(r.time % 1000000000 / 1000),
+                         r.received ? '<' : '>', typeName(r.type));
+        if (r.name_length != 0 || r.text_length != 0) line[n++] = ' ';
+        if (r.name_length != 0) {
+            memcpy(line + n, r.name, r.name_length);
+            n += r.name_length;
+            line[n++] = ':';
+            line[n++] = ' ';
+        }
+        memcpy(line + n, r.text, r.text_length);
+        n += r.text_length;
+        if (r.truncated) {
+            memcpy(line + n, " [truncated]", 12);
+            n += 12;
+        }
+        line[n++] = '\n';
+        length += n;
+        records++;
+        pending++;
+
+        // The record is formatted, its slot can be filled again
+        tail.store(t + 1, std::memory_order_release);
+
+        if (length + LINE_SIZE > BATCH_SIZE) {
+            flushBatch(length, pending);
+            length = pending = 0;
+        }
+    }
+    if (length != 0) flushBatch(length, pending);
+
+    return records;
+}
+
+void Transcript::flushBatch(size_t length, size_t records) {
+    // Records that couldn't be written are lost like the ones that didn't fit into the ring
+    if (append(batch.get(), length)) written_records.fetch_add(records, std::memory_order_relaxed);
+    else dropped_records.fetch_add(records, std::memory_order_relaxed);
+}
+
+bool Transcript::append(const char* data, size_t length) {
+    if (fd == -1) return false; // Failed before, records are only drained
+
+    if (rotate_size != 0 && file_size != 0 && file_size + length > rotate_size && !rotate()) return false;
+
+    // Reserved ahead, so the file system doesn't allocate blocks on every write().
+    // KEEP_SIZE leaves the file length alone, readers never see the reserved space.
+    if (file_size + length > allocated) {
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, file_size, PREALLOCATE) == 0) allocated = file_size + PREALLOCATE;
+        else allocated = UINT64_MAX; // Not supported by the file system, don't try again
+    }
+
+    for (size_t done = 0; done < length;) {
+        ssize_t bytes = write(fd, data + done, length - done);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) {
+            int expected = 0;
+            write_error.compare_exchange_strong(expected, errno);
+            closeFile();
+            return false;
+        }
+        done += bytes;
+    }
+    file_size += length;
+    written_batches.fetch_add(1, std::memory_order_relaxed);
+
+    if (sync == TranscriptSync::BATCH) fdatasync(fd);
+    return true;
+}
+
+bool Transcript::openFile() {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return false;
+
+    // Appended to what an earlier session left there
+    off_t end = lseek(fd, 0, SEEK_END);
+    file_size = end > 0 ? end : 0;
+    allocated = file_size;
+    return true;
+}
+
+void Transcript::closeFile() {
+    if (fd == -1) return;
+
+    // Blocks reserved by fallocate() past the end would stay with the closed file
+    if (allocated != UINT64_MAX && allocated > file_size && ftruncate(fd, file_size) == -1) {
+        int expected = 0;
+        write_error.compare_exchange_strong(expected, errno);
+    }
+    if (sync != TranscriptSync::NONE) fdatasync(fd);
+    close(fd);
+    fd = -1;
+}
+
+bool Transcript::rotate() {
+    closeFile();
+
+    // Next free <path>.<n>, the live file is always <path>
+    std::string rotated;
+    do {
+        rotated = path + "." + std::to_string(++rotations);
+    } while (access(rotated.c_str(), F_OK) == 0);
+
+    if (rename(path.c_str(), rotated.c_str()) == -1 || !openFile()) {
+        int expected = 0;
+        write_error.compare_exchange_strong(expected, errno);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+uint64_t Transcript::written() const {
+    return written_records.load(std::memory_order_relaxed);
+}
+
+uint64_t Transcript::dropped() const {
+    return dropped_records.load(std::memory_order_relaxed);
+}
+
+uint64_t Transcript::batches() const {
+    return written_batches.load(std::memory_order_relaxed);
+}
+
+int Transcript::error() const {
+    return write_error.load(std::memory_order_relaxed);
+}
+
+bool Transcript::parseSync(std::string_view name, TranscriptSync& sync) {
+    if (name == "none") sync = TranscriptSync::NONE;
+    else if (name == "rotate") sync = TranscriptSync::ROTATE;
+    else if (name == "batch") sync = TranscriptSync::BATCH;
+    else return false;
+    return true;
+}
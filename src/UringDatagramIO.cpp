@@ -0,0 +1,381 @@
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include "UringDatagramIO.h"
+
+// Completions of the multishot receive, sends carry their Outbox
+static constexpr uint64_t RECV_TAG = 0;
+static constexpr uint64_t CANCEL_TAG = 1;
+static constexpr uint16_t BUFFER_GROUP = 0;
+
+static unsigned roundUpPow2(size_t value) {
+    unsigned result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+UringDatagramIO::UringDatagramIO(size_t size)
+: batch_size(size == 0 ? 1 : size), ring_fd(-1), socket_fd(-1), armed(false),
+  sq_ring(MAP_FAILED), sq_ring_size(0), cq_ring(MAP_FAILED), cq_ring_size(0), sqes(nullptr), sqes_size(0),
+  sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr), sq_array(nullptr),
+  cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), cqes(nullptr), sq_entries(0), sq_pending(0),
+  buf_ring(nullptr), buf_ring_size(0), buffer_count(0), buf_tail(0), recv_msg{}, handed_out(0), recv_error(0),
+  filling(nullptr), sends_in_flight(0), send_error(0) {
+    if (!setup()) {
+        if (ring_fd != -1) close(ring_fd);
+        ring_fd = -1;
+        return;
+    }
+
+    filling = takeOutbox();
+}
+
+UringDatagramIO::~UringDatagramIO() {
+    if (ring_fd != -1) {
+        // Kernel may still write into the buffers, wait until it let go of them
+        if (armed) {
+            struct io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = RECV_TAG;
+            sqe->user_data = CANCEL_TAG;
+        }
+
+        reap();
+        while ((armed || sends_in_flight > 0) && submit(1)) reap();
+
+        close(ring_fd);
+    }
+
+    if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sqes != nullptr) munmap(sqes, sqes_size);
+    if (buf_ring != nullptr) munmap(buf_ring, buf_ring_size);
+}
+
+bool UringDatagramIO::setup() {
+    // Sends of one flush and the receive fit in the submission queue, receive completions
+    // of every buffer and the sends fit in the completion queue
+    unsigned entries = roundUpPow2(batch_size + 2);
+    buffer_count = std::min(roundUpPow2(std::max<size_t>(2 * batch_size, 64)), 32768u); // Buffer IDs are 16 bit
+
+    struct io_uring_params params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = roundUpPow2(2 * (buffer_count + entries));
+
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0) {
+        ring_fd = -1;
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) return false;
+
+    cq_ring = single_mmap ? sq_ring
+        : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) return false;
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED) return false;
+    sqes = static_cast<struct io_uring_sqe*>(sqes_map);
+
+    char* sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries = params.sq_entries;
+
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Both operations have to be there, multishot support itself is checked when the receive is armed
+    std::vector<uint8_t> probe_data(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(probe_data.data());
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+    for (int op : {IORING_OP_RECVMSG, IORING_OP_SENDMSG}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+
+    // Ring of provided buffers has to be page aligned
+    buf_ring_size = buffer_count * sizeof(struct io_uring_buf);
+    void* ring_map = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_map == MAP_FAILED) return false;
+    buf_ring = static_cast<struct io_uring_buf_ring*>(ring_map);
+
+    struct io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+
+    buffers.resize(buffer_count * BUFFER_SIZE);
+    for (unsigned i = 0; i < buffer_count; i++) recycle(i);
+
+    // Kernel writes the sender address in front of the payload, room for either family
+    recv_msg.msg_namelen = sizeof(struct sockaddr_in6);
+    recv_msg.msg_controllen = 0;
+
+    return true;
+}
+
+bool UringDatagramIO::valid() const {
+    return ring_fd != -1;
+}
+
+bool UringDatagramIO::start(int fd) {
+    if (!valid()) return false;
+
+    socket_fd = fd;
+    arm();
+
+    // Unsupported multishot receive fails right at submission
+    reap();
+    if (!armed) {
+        if (recv_error != 0) errno = recv_error; // Otherwise set by the failed submission
+        recv_error = 0;
+        return false;
+    }
+
+    return true;
+}
+
+int UringDatagramIO::pollFd() const {
+    return ring_fd;
+}
+
+struct io_uring_sqe* UringDatagramIO::nextSqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (*sq_tail + sq_pending - head >= sq_entries) submit(0);
+
+    unsigned index = (*sq_tail + sq_pending) & *sq_mask;
+    sq_array[index] = index;
+    sq_pending++;
+
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool UringDatagramIO::submit(unsigned wait_for) {
+    unsigned to_submit = sq_pending;
+    __atomic_store_n(sq_tail, *sq_tail + sq_pending, __ATOMIC_RELEASE);
+    sq_pending = 0;
+
+    unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_for, flags, nullptr, 0) < 0) {
+        if (errno != EINTR) return false;
+        to_submit = 0; // Interrupted while waiting, everything was submitted already
+    }
+
+    return true;
+}
+
+void UringDatagramIO::arm() {
+    struct io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&recv_msg);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = RECV_TAG;
+
+    armed = submit(0);
+}
+
+void UringDatagramIO::reap() {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe& cqe = cqes[head & *cq_mask];
+
+        if (cqe.user_data == RECV_TAG) {
+            // Out of buffers or failed, armed again by the next receive()
+            if (!(cqe.flags & IORING_CQE_F_MORE)) armed = false;
+
+            if (cqe.res < 0) {
+                if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED) recv_error = -cqe.res;
+                continue;
+            }
+            if (!(cqe.flags & IORING_CQE_F_BUFFER)) continue;
+
+            // Buffer holds io_uring_recvmsg_out, the sender address and the payload
+            uint16_t buffer_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            const uint8_t* buffer = buffers.data() + buffer_id * BUFFER_SIZE;
+            struct io_uring_recvmsg_out out;
+            memcpy(&out, buffer, sizeof(out));
+
+            size_t offset = sizeof(out) + recv_msg.msg_namelen + recv_msg.msg_controllen;
+            size_t available = static_cast<size_t>(cqe.res) > offset ? cqe.res - offset : 0;
+
+            Received received = {};
+            received.buffer_id = buffer_id;
+            received.payload = buffer + offset;
+            received.length = std::min<size_t>(out.payloadlen, available);
+            memcpy(&received.addr, buffer + sizeof(out), std::min<size_t>(out.namelen, sizeof(received.addr)));
+            received.truncated = out.flags & MSG_TRUNC;
+            delivered.push_back(received);
+        } else if (cqe.user_data != CANCEL_TAG) {
+            Outbox* outbox = reinterpret_cast<Outbox*>(cqe.user_data);
+            if (cqe.res < 0) send_error = -cqe.res;
+
+            sends_in_flight--;
+            if (--outbox->in_flight == 0) free_outboxes.push_back(outbox);
+        }
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+void UringDatagramIO::recycle(uint16_t buffer_id) {
+    // Not buf_ring->bufs, its flexible array is shifted by an empty struct in C++
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(buf_ring) + (buf_tail & (buffer_count - 1));
+    buf->addr = reinterpret_cast<uint64_t>(buffers.data() + buffer_id * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = buffer_id;
+
+    buf_tail++;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+int UringDatagramIO::receive(int) {
+    // Datagrams of the previous call were processed, their buffers go back to the kernel
+    for (size_t i = 0; i < handed_out; i++) recycle(delivered[i].buffer_id);
+    delivered.erase(delivered.begin(), delivered.begin() + handed_out);
+
+    reap();
+    if (!armed) arm();
+    handed_out = delivered.size();
+
+    if (delivered.empty() && recv_error != 0) {
+        errno = recv_error;
+        recv_error = 0;
+        return -1;
+    }
+
+    if (!delivered.empty()) {
+        counters.recv_calls++;
+        counters.recv_datagrams += delivered.size();
+    }
+
+    return delivered.size();
+}
+
+std::span<const uint8_t> UringDatagramIO::datagram(int index) const {
+    return std::span<const uint8_t>(delivered[index].payload, delivered[index].length);
+}
+
+const struct sockaddr_storage& UringDatagramIO::sender(int index) const {
+    return delivered[index].addr;
+}
+
+bool UringDatagramIO::truncated(int index) const {
+    return delivered[index].truncated;
+}
+
+UringDatagramIO::Outbox* UringDatagramIO::takeOutbox() {
+    if (!free_outboxes.empty()) {
+        Outbox* outbox = free_outboxes.back();
+        free_outboxes.pop_back();
+        outbox->used = 0;
+        outbox->count = 0;
+        return outbox;
+    }
+
+    // Every outbox still waits for its sends to complete
+    auto outbox = std::make_unique<Outbox>();
+    outbox->data.resize(SEND_ARENA_SIZE);
+    outbox->iov.resize(batch_size);
+    outbox->msgs.resize(batch_size);
+    outboxes.push_back(std::move(outbox));
+
+    return outboxes.back().get();
+}
+
+bool UringDatagramIO::queue(std::span<const std::byte> data) {
+    if (filling->count == batch_size || data.size() > SEND_ARENA_SIZE - filling->used) return false;
+
+    std::byte* copy = filling->data.data() + filling->used;
+    memcpy(copy, data.data(), data.size());
+    filling->used += data.size();
+
+    filling->iov[filling->count].iov_base = copy;
+    filling->iov[filling->count].iov_len = data.size();
+    filling->count++;
+
+    return true;
+}
+
+bool UringDatagramIO::pending() const {
+    return filling->count != 0;
+}
+
+bool UringDatagramIO::flush(int fd, const struct sockaddr_storage& dest) {
+    if (filling->count == 0) return true;
+
+    Outbox* outbox = filling;
+    outbox->dest = dest;
+
+    for (size_t i = 0; i < outbox->count; i++) {
+        struct msghdr& msg = outbox->msgs[i];
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &outbox->dest;
+        msg.msg_namelen = addressLength(outbox->dest);
+        msg.msg_iov = &outbox->iov[i];
+        msg.msg_iovlen = 1;
+
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&msg);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(outbox);
+    }
+
+    // Whole outbox goes to the kernel by one system call, completions are reaped by receive()
+    outbox->in_flight = outbox->count;
+    sends_in_flight += outbox->count;
+    counters.send_calls++;
+    counters.send_datagrams += outbox->count;
+
+    bool ok = submit(0);
+    if (!ok) {
+        sends_in_flight -= outbox->in_flight;
+        outbox->in_flight = 0;
+        free_outboxes.push_back(outbox);
+    }
+
+    filling = takeOutbox();
+
+    if (send_error != 0) {
+        errno = send_error;
+        send_error = 0;
+        ok = false;
+    }
+
+    return ok;
+}
+
+const UringDatagramIO::Stats& UringDatagramIO::stats() const {
+    return counters;
+}
+
+const char* UringDatagramIO::name() const {
+    return "io_uring";
+}
@@ -1,21 +1,107 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VALIDATION_X86 1
+#endif
+
 #include "ValidationHelpers.h"
 
-bool isValidId(const std::string& id) {
-    std::regex id_pattern(R"(^[A-Za-z0-9-]{1,20}$)");
-    return std::regex_match(id, id_pattern);
+namespace {
+    using CharClass = std::array<bool, 256>;
+
+    constexpr CharClass rangeClass(unsigned char first, unsigned char last) {
+        CharClass table{};
+        for (unsigned c = first; c <= last; c++) table[c] = true;
+        return table;
+    }
+
+    constexpr CharClass idClass() {
+        CharClass table{};
+        for (unsigned c = 'A'; c <= 'Z'; c++) table[c] = true;
+        for (unsigned c = 'a'; c <= 'z'; c++) table[c] = true;
+        for (unsigned c = '0'; c <= '9'; c++) table[c] = true;
+        table['-'] = true;
+        return table;
+    }
+
+    constexpr CharClass ID_CHARS = idClass();                 // [A-Za-z0-9-]
+    constexpr CharClass VCHAR = rangeClass(0x21, 0x7E);       // Visible characters
+    constexpr CharClass VCHAR_SP = rangeClass(0x20, 0x7E);    // VCHAR plus space
+
+    bool matches(std::string_view text, const CharClass& allowed, size_t max_length) {
+        if (text.empty() || text.size() > max_length) return false;
+
+        for (unsigned char c : text) {
+            if (!allowed[c]) return false;
+        }
+        return true;
+    }
+
+    // Index of the first byte outside 0x20-0x7E starting at `from`, scalar version
+    size_t printableScalar(const unsigned char* data, size_t from, size_t size) {
+        while (from < size && VCHAR_SP[data[from]]) from++;
+        return from;
+    }
+
+#ifdef VALIDATION_X86
+    // Bytes are compared as signed, so everything >= 0x80 is negative and fails the lower bound
+
+    size_t printableSse2(const unsigned char* data, size_t size) {
+        const __m128i low = _mm_set1_epi8(0x1F);
+        const __m128i high = _mm_set1_epi8(0x7F);
+        size_t i = 0;
+
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+            if (_mm_movemask_epi8(ok) != 0xFFFF) return printableScalar(data, i, size);
+        }
+        return printableScalar(data, i, size);
+    }
+
+    __attribute__((target("avx2")))
+    size_t printableAvx2(const unsigned char* data, size_t size) {
+        const __m256i low = _mm256_set1_epi8(0x1F);
+        const __m256i high = _mm256_set1_epi8(0x7F);
+        size_t i = 0;
+
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, low), _mm256_cmpgt_epi8(high, chunk));
+            if (static_cast<uint32_t>(_mm256_movemask_epi8(ok)) != 0xFFFFFFFFu) return printableScalar(data, i, size);
+        }
+        return printableScalar(data, i, size);
+    }
+
+    using PrintableScan = size_t (*)(const unsigned char*, size_t);
+
+    // Picked once, the CPU doesn't change while we run
+    const PrintableScan printableScan = __builtin_cpu_supports("avx2") ? printableAvx2 : printableSse2;
+#else
+    size_t printableScan(const unsigned char* data, size_t size) {
+        return printableScalar(data, 0, size);
+    }
+#endif
 }
 
-bool isValidSecret(const std::string& secret) {
-    std::regex secret_pattern(R"(^[A-Za-z0-9-]{1,128}$)");
-    return std::regex_match(secret, secret_pattern);
+bool isValidId(std::string_view id) {
+    return matches(id, ID_CHARS, 20);
 }
 
-bool isValidDName(const std::string& dname) {
-    std::regex dname_pattern(R"(^[\x21-\x7E]{1,20}$)"); // VCHAR matches characters in the range 0x21-0x7E
-    return std::regex_match(dname, dname_pattern);
+bool isValidSecret(std::string_view secret) {
+    return matches(secret, ID_CHARS, 128);
 }
 
-bool isValidContent(const std::string& content) {
-    std::regex content_pattern(R"(^[\x20-\x7E]{1,1400}$)"); // VCHAR plus space (0x20)
-    return std::regex_match(content, content_pattern);
-}
\ No newline at end of file
+bool isValidDName(std::string_view dname) {
+    return matches(dname, VCHAR, 20);
+}
+
+bool isValidContent(std::string_view content) {
+    if (content.empty() || content.size() > 1400) return false;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(content.data());
+    return printableScan(data, content.size()) == content.size();
+}
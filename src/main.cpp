@@ -1,3 +1,5 @@
+#include <unistd.h>
+#include <cerrno>
 #include <cstdlib>
 #include <csignal>
 #include <iostream>
@@ -6,21 +8,31 @@
 #include "CommandLineParser.h"
 #include "ChatClient.h"
 
-ChatClient* client = nullptr; // Global pointer to ChatClient instance
+// Global pointer to ChatClient instance. Atomic, the signal handlers may run while it's swapped out
+std::atomic<ChatClient*> client(nullptr);
 std::atomic<bool> shutdownRequested(false);
 
 void handle_sigint(int sig) {
-    if (client != nullptr) {
+    ChatClient* current = client.load();
+    if (current != nullptr) {
         std::cerr << "ERR: Ctrl+C pressed. Shutting down..." << std::endl;
-        delete client;
-        client = nullptr;
+        current->interrupt(); // runCLI() returns and the client says BYE when deleted
     }
 
     return;
 }
 
+void handle_sigusr1(int sig) {
+    // The interrupted code may be about to check errno of its own failed call
+    int saved_errno = errno;
+    ChatClient* current = client.load();
+    if (current != nullptr) current->dumpMetrics(STDERR_FILENO); // Only write(), no buffered streams
+    errno = saved_errno;
+}
+
 int main(int argc, char* argv[]) {
     std::signal(SIGINT, handle_sigint); // Register signal handler
+    std::signal(SIGUSR1, handle_sigusr1); // Metrics dump
     
     if (argc < 2) {
         std::cerr << "ERR: Not enough arguments!" << std::endl;
@@ -40,19 +52,15 @@ int main(int argc, char* argv[]) {
     }
 
     client = new ChatClient(config);
-    if (!client->connectToServer()) {
+    if (!client.load()->connectToServer()) {
         std::cerr << "ERR: Could not connect to the server." << std::endl;
-        delete client;
-        client = nullptr;
+        delete client.exchange(nullptr); // Handlers no longer see it when it's deleted
         return EXIT_FAILURE;
     }
 
-    int status = client->runCLI();
+    int status = client.load()->runCLI();
 
-    if (client != nullptr) {
-        delete client;
-        client = nullptr;
-    }
+    delete client.exchange(nullptr);
 
     return status;
 }
\ No newline at end of file
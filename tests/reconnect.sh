@@ -0,0 +1,94 @@
+#!/bin/sh
+# Reconnect (-R) against a restarted ipk24chat-server, for both variants.
+# Client A is authenticated when the server is killed, the server comes back
+# 200 ms later. A must reconnect, replay its AUTH and get a message after the
+# restart to client B, which connects only to the new server.
+# Run by `make test` from the repository root.
+
+CLIENT=./ipk24chat-client
+SERVER=./ipk24chat-server
+PORT=${PORT:-47311}
+TMP=$(mktemp -d)
+SERVER_PID=
+
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null
+    exec 3>&- 4>&- 2>/dev/null
+    rm -rf "$TMP"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+trap '' PIPE # A client that already exited is reported below, not by killing the script
+
+start_server() {
+    # Without the FIFO write ends, the clients must see their end of input
+    $SERVER -p "$PORT" >/dev/null 2>&1 3>&- 4>&- &
+    SERVER_PID=$!
+    sleep 0.2
+    if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+        echo "server did not start on port $PORT" >&2
+        SERVER_PID=
+        exit 1
+    fi
+}
+
+run() {
+    transport=$1
+    mkfifo "$TMP/a.in" "$TMP/b.in"
+
+    start_server
+    $CLIENT -t "$transport" -s 127.0.0.1 -p "$PORT" -R 5 <"$TMP/a.in" >"$TMP/a.out" 2>"$TMP/a.err" &
+    a_pid=$!
+    exec 3>"$TMP/a.in"
+    echo "/auth alice secret Alice" >&3
+    sleep 0.3
+
+    kill "$SERVER_PID"
+    wait "$SERVER_PID" 2>/dev/null
+    sleep 0.2
+    start_server
+
+    $CLIENT -t "$transport" -s 127.0.0.1 -p "$PORT" <"$TMP/b.in" >"$TMP/b.out" 2>"$TMP/b.err" 3>&- &
+    b_pid=$!
+    exec 4>"$TMP/b.in"
+    echo "/auth bob secret Bob" >&4
+    sleep 0.3
+
+    # UDP notices the restart only when this message goes unconfirmed
+    echo "after restart" >&3 2>/dev/null
+    sleep 2
+    exec 3>&- 4>&-
+    wait "$a_pid"
+    a_status=$?
+    wait "$b_pid"
+    kill "$SERVER_PID"
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=
+
+    failed=0
+    if [ "$a_status" -ne 0 ]; then
+        echo "$transport: client exited with $a_status" >&2
+        failed=1
+    fi
+    if ! grep -q "^Reconnected in" "$TMP/a.err"; then
+        echo "$transport: client did not reconnect" >&2
+        failed=1
+    fi
+    if ! grep -q "^Alice: after restart$" "$TMP/b.out"; then
+        echo "$transport: message sent after the restart was not delivered" >&2
+        failed=1
+    fi
+    if [ "$failed" -ne 0 ]; then
+        sed "s/^/  /" "$TMP/a.err" >&2
+        rm -f "$TMP"/*
+        return 1
+    fi
+
+    echo "$transport: $(grep "^Reconnected in" "$TMP/a.err")"
+    rm -f "$TMP"/*
+}
+
+status=0
+run tcp || status=1
+run udp || status=1
+exit $status
@@ -0,0 +1,304 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/timerfd.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ChatClient.h"
+#include "Reactor.h"
+
+// Load generator: many ChatClient sessions in one reactor, each of them authenticates,
+// joins the channel and sends messages stamped with the send time. Every other session
+// in the channel measures the delivery latency from the stamp.
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    AppConfig client;     // Server, UDP options
+    int tcp_sessions = 1;
+    int udp_sessions = 0;
+    int messages = 100;   // Per session
+    double rate = 0;      // Messages per second per session, 0 for as fast as possible
+    std::string channel = "bench";
+    int grace = 2000;     // Milliseconds to wait for deliveries after the last send
+    bool valid = true;
+};
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// One simulated user
+class Session : public SessionObserver {
+public:
+    enum class State { AUTH, JOIN, SENDING, DONE, FAILED };
+
+    static constexpr std::chrono::seconds SETUP_TIMEOUT{10}; // To authenticate and join
+
+    Session(const BenchConfig& bench, AppConfig config, int index)
+    : client(std::make_unique<ChatClient>(config, this)), bench(bench), index(index), created(Clock::now()) {
+        client->mute();
+    }
+
+    bool start(Reactor& reactor) {
+        if (!client->connectToServer() || !client->attach(reactor)) {
+            state = State::FAILED;
+            return false;
+        }
+
+        auth_sent = nowNs();
+        std::string user = "bench" + std::to_string(index);
+        client->submitLine("/auth " + user + " secret " + user);
+        return true;
+    }
+
+    void onReply(bool success, std::string_view) override {
+        if (!success) {
+            state = State::FAILED;
+            return;
+        }
+
+        if (state == State::AUTH) {
+            auth_latency = nowNs() - auth_sent;
+            state = State::JOIN;
+            client->submitLine("/join " + bench.channel);
+        } else if (state == State::JOIN) {
+            state = bench.messages > 0 ? State::SENDING : State::DONE;
+            started = Clock::now();
+        }
+    }
+
+    void onMessage(std::string_view, std::string_view content) override {
+        // Only the stamped messages of other sessions, not server announcements
+        if (content.size() < 2 || content[0] != 't') return;
+
+        uint64_t stamp = 0;
+        auto result = std::from_chars(content.data() + 1, content.data() + content.size(), stamp);
+        if (result.ec != std::errc() || (result.ptr != content.data() + content.size() && *result.ptr != ' ')) return;
+
+        latencies.push_back(nowNs() - stamp);
+        last_delivery = Clock::now();
+    }
+
+    // Sends what is due by now, true while some messages are left or wait for CONFIRM
+    bool pump(Clock::time_point now, size_t burst) {
+        if (client->finished() || ((state == State::AUTH || state == State::JOIN) && now - created > SETUP_TIMEOUT)) state = State::FAILED;
+        if (state != State::SENDING) return state == State::AUTH || state == State::JOIN;
+
+        size_t sent_now = 0;
+        while (sent < bench.messages && sent_now < burst) {
+            if (bench.rate > 0 && now < started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sent / bench.rate))) break;
+
+            char line[64];
+            auto result = std::to_chars(line, line + 32, nowNs());
+            *result.ptr++ = ' ';
+            result = std::to_chars(result.ptr, line + sizeof(line), sent);
+
+            // Stamp is prefixed with 't', content can't start with '/'
+            std::string text = "t" + std::string(line, result.ptr);
+            if (!client->submitLine(text)) break; // Command queue is full, retried later
+
+            sent++;
+            sent_now++;
+        }
+
+        // Done once the last message left the command queue and was confirmed
+        if (sent == bench.messages && client->idle()) {
+            state = State::DONE;
+            finished_at = Clock::now();
+        }
+
+        return state == State::SENDING;
+    }
+
+    std::unique_ptr<ChatClient> client;
+    State state = State::AUTH;
+    int sent = 0;
+    uint64_t auth_sent = 0, auth_latency = 0;
+    Clock::time_point started, finished_at, last_delivery;
+    std::vector<uint64_t> latencies; // Of messages received from the other sessions
+
+private:
+    const BenchConfig& bench;
+    int index;
+    Clock::time_point created;
+};
+
+// Feeds the sessions with messages, on a 1 ms timer or on every loop iteration without a rate limit
+class Pacer : public EventHandler {
+public:
+    Pacer(Reactor& reactor, std::vector<std::unique_ptr<Session>>& sessions, const BenchConfig& bench)
+    : reactor(reactor), sessions(sessions), bench(bench), timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+        struct itimerspec spec = {};
+        spec.it_interval.tv_nsec = 1000000;
+        spec.it_value.tv_nsec = 1000000;
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+        reactor.add(timer_fd, EPOLLIN, this);
+        reactor.attach(this);
+    }
+
+    ~Pacer() override {
+        close(timer_fd);
+    }
+
+    void onEvent(int fd, uint32_t) override {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) < 0) return;
+    }
+
+    void afterEvents() override {
+        auto now = Clock::now();
+        bool busy = false;
+        for (auto& session : sessions) busy |= session->pump(now, 64);
+
+        if (busy) {
+            if (bench.rate == 0) reactor.schedule(this);
+            return;
+        }
+
+        // Everything was sent, deliveries get the grace period
+        if (done_at == Clock::time_point()) done_at = now;
+        if (now - done_at >= std::chrono::milliseconds(bench.grace)) {
+            reactor.remove(timer_fd);
+            reactor.stop();
+        }
+    }
+
+private:
+    Reactor& reactor;
+    std::vector<std::unique_ptr<Session>>& sessions;
+    const BenchConfig& bench;
+    int timer_fd;
+    Clock::time_point done_at; // When the last session sent everything
+};
+
+static void printUsage() {
+    std::cerr << "usage: ipk24chat-bench -s <server> [-p <port>] [-T <tcp_sessions>] [-U <udp_sessions>] [-m <messages>] [-R <rate>] [-c <channel>] [-g <grace_ms>] [-d <timeout>] [-r <retransmissions>] [-w <window>] [-b <batch>] [-i batch|uring]\n";
+    std::cerr << "  -T/-U <n>\tNumber of TCP/UDP sessions, default is 1 TCP and 0 UDP.\n";
+    std::cerr << "  -m <n>\tMessages sent by every session, default is 100.\n";
+    std::cerr << "  -R <rate>\tMessages per second per session, 0 (default) sends as fast as possible.\n";
+    std::cerr << "  -c <channel>\tChannel all sessions join, default is bench.\n";
+    std::cerr << "  -g <ms>\tHow long to wait for deliveries after the last message was sent, default is 2000.\n";
+    std::cerr << "  Other options are the same as for ipk24chat-client.\n";
+}
+
+static BenchConfig parseArguments(int argc, char* argv[]) {
+    BenchConfig bench;
+    bench.client.window_size = 32;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:T:U:m:R:c:g:d:r:w:b:i:h")) != -1) {
+        try {
+            switch (opt) {
+                case 's': bench.client.server_address = optarg; break;
+                case 'p': bench.client.port = std::stoi(optarg); break;
+                case 'T': bench.tcp_sessions = std::stoi(optarg); break;
+                case 'U': bench.udp_sessions = std::stoi(optarg); break;
+                case 'm': bench.messages = std::stoi(optarg); break;
+                case 'R': bench.rate = std::stod(optarg); break;
+                case 'c': bench.channel = optarg; break;
+                case 'g': bench.grace = std::stoi(optarg); break;
+                case 'd': bench.client.timeout = std::stoi(optarg); break;
+                case 'r': bench.client.retransmissions_number = std::stoi(optarg); break;
+                case 'w': bench.client.window_size = std::stoi(optarg); break;
+                case 'b': bench.client.batch_size = std::stoi(optarg); break;
+                case 'i': bench.client.io_backend = optarg; break;
+                default: bench.valid = false; return bench;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "ERR: Wrong value of -" << static_cast<char>(opt) << " : " << e.what() << std::endl;
+            bench.valid = false;
+            return bench;
+        }
+    }
+
+    if (bench.client.server_address.empty() || bench.tcp_sessions < 0 || bench.udp_sessions < 0 || bench.messages < 0 || bench.rate < 0
+        || bench.client.window_size < 1 || bench.client.window_size > SendWindow::MAX_SIZE || bench.client.batch_size < 1 || bench.client.batch_size > 1024) {
+        bench.valid = false;
+    }
+
+    return bench;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void printLatency(const char* name, std::vector<uint64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    std::cout << name << " latency (us): samples " << samples.size();
+    for (auto [label, p] : {std::pair{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p99.9", 99.9}}) {
+        std::cout << " " << label << " " << percentile(samples, p) / 1000.0;
+    }
+    std::cout << " max " << (samples.empty() ? 0 : samples.back()) / 1000.0 << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig bench = parseArguments(argc, argv);
+    if (!bench.valid) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    Reactor reactor;
+    if (!reactor.valid()) return EXIT_FAILURE;
+
+    std::vector<std::unique_ptr<Session>> sessions;
+    int total = bench.tcp_sessions + bench.udp_sessions;
+    for (int i = 0; i < total; i++) {
+        AppConfig config = bench.client;
+        config.transport_protocol = i < bench.tcp_sessions ? "tcp" : "udp";
+        sessions.push_back(std::make_unique<Session>(bench, config, i));
+        sessions.back()->start(reactor);
+    }
+
+    Pacer pacer(reactor, sessions, bench);
+    reactor.run();
+
+    // Summary, rates are measured from the first sent message
+    int ready = 0, failed = 0;
+    uint64_t sent = 0, received = 0;
+    Clock::time_point first_send = Clock::time_point::max(), last_send, last_delivery;
+    std::vector<uint64_t> delivery, auth;
+    for (auto& session : sessions) {
+        if (session->state == Session::State::FAILED) failed++;
+        else if (session->state == Session::State::DONE) ready++;
+        if (session->auth_latency != 0) auth.push_back(session->auth_latency);
+        if (session->sent > 0) {
+            first_send = std::min(first_send, session->started);
+            last_send = std::max(last_send, session->finished_at);
+        }
+        last_delivery = std::max(last_delivery, session->last_delivery);
+        sent += session->sent;
+        received += session->latencies.size();
+        delivery.insert(delivery.end(), session->latencies.begin(), session->latencies.end());
+    }
+
+    double send_seconds = sent > 0 ? std::chrono::duration<double>(last_send - first_send).count() : 0;
+    double receive_seconds = received > 0 ? std::chrono::duration<double>(last_delivery - first_send).count() : 0;
+    uint64_t expected = ready > 1 ? sent * (ready - 1) : 0;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "sessions: " << bench.tcp_sessions << " tcp, " << bench.udp_sessions << " udp, "
+              << ready << " completed, " << failed << " failed" << std::endl;
+    std::cout << "sent: " << sent << " messages in " << std::setprecision(3) << send_seconds << std::setprecision(1) << " s ("
+              << (send_seconds > 0 ? sent / send_seconds : 0) << " msg/s)" << std::endl;
+    std::cout << "received: " << received << " of " << expected << " expected deliveries in " << std::setprecision(3) << receive_seconds << std::setprecision(1) << " s ("
+              << (receive_seconds > 0 ? received / receive_seconds : 0) << " msg/s)" << std::endl;
+    printLatency("auth", auth);
+    printLatency("delivery", delivery);
+
+    sessions.clear(); // Sessions say BYE
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,452 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Messages.h"
+#include "ChatClient.h"
+#include "ValidationHelpers.h"
+#include "TraceRing.h"
+#include "Transcript.h"
+
+// Microbenchmarks of the message codecs and validators. Every case cycles through a
+// corpus of realistic inputs and reports ns/op, heap allocations/op and throughput
+// as CSV, so results of two commits can be diffed or compared with -c.
+
+using Clock = std::chrono::steady_clock;
+
+// Every heap allocation of the process goes through here. The replaced operators pair
+// malloc() with free(), GCC doesn't see that once they are inlined with -O2.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+static uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size != 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// Keeps the compiler from dropping a result that is never used
+template<typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct MicrobenchConfig {
+    int min_time = 200; // Milliseconds of one timed run
+    int repeats = 3;    // Timed runs, the fastest one is reported
+    std::string filter; // Only cases whose name contains this
+    std::string baseline; // CSV of an earlier run
+    bool valid = true;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+};
+
+class Runner {
+public:
+    explicit Runner(const MicrobenchConfig& config) : config(config) {}
+
+    // op(i) runs one operation on the i-th input, bytes is the average input or output size
+    template<typename F>
+    void run(const std::string& name, double bytes, F op) {
+        if (name.find(config.filter) == std::string::npos) return;
+
+        // Doubles the batch until one batch takes min_time
+        auto target = std::chrono::milliseconds(config.min_time);
+        uint64_t iterations = 1;
+        while (true) {
+            auto elapsed = batch(iterations, op);
+            if (elapsed >= target || iterations >= (uint64_t(1) << 40)) break;
+
+            double scale = elapsed.count() > 0 ? double(target.count()) * 1e6 / elapsed.count() : 100;
+            iterations = uint64_t(iterations * std::clamp(scale * 1.2, 2.0, 100.0));
+        }
+
+        Result result{name, iterations, 0, 0, bytes};
+        double best = -1;
+        for (int i = 0; i < config.repeats; i++) {
+            uint64_t before = allocations;
+            auto elapsed = batch(iterations, op);
+            double ns = double(elapsed.count()) / iterations;
+            if (best < 0 || ns < best) best = ns;
+            result.allocs_per_op = double(allocations - before) / iterations;
+        }
+        result.ns_per_op = best;
+        results.push_back(result);
+    }
+
+    void print(const std::unordered_map<std::string, double>& baseline) const {
+        std::cout << "name,iterations,ns_per_op,allocs_per_op,bytes_per_op,mb_per_s,mops_per_s";
+        if (!baseline.empty()) std::cout << ",baseline_ns_per_op,change_pct";
+        std::cout << '\n' << std::fixed;
+
+        for (const Result& result : results) {
+            std::cout << result.name << ',' << result.iterations << ','
+                      << std::setprecision(2) << result.ns_per_op << ','
+                      << std::setprecision(2) << result.allocs_per_op << ','
+                      << std::setprecision(1) << result.bytes_per_op << ','
+                      << std::setprecision(1) << result.bytes_per_op * 1e3 / result.ns_per_op << ','
+                      << std::setprecision(3) << 1e3 / result.ns_per_op;
+
+            if (!baseline.empty()) {
+                auto old = baseline.find(result.name);
+                if (old != baseline.end()) {
+                    std::cout << ',' << std::setprecision(2) << old->second << ','
+                              << std::setprecision(1) << (result.ns_per_op / old->second - 1) * 100;
+                } else {
+                    std::cout << ",,";
+                }
+            }
+            std::cout << '\n';
+        }
+    }
+
+private:
+    const MicrobenchConfig& config;
+    std::vector<Result> results;
+
+    template<typename F>
+    std::chrono::nanoseconds batch(uint64_t iterations, F& op) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) op(i);
+        return Clock::now() - start;
+    }
+};
+
+// Deterministic inputs shaped like real chat traffic
+class Corpus {
+public:
+    static constexpr size_t SIZE = 256; // Power of two, inputs are picked by i & (SIZE - 1)
+
+    Corpus() : random(42) {}
+
+    std::string id(size_t min, size_t max) {
+        static constexpr std::string_view chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-";
+        return pick(min, max, chars);
+    }
+
+    std::string displayName() {
+        std::string name;
+        size_t length = uniform(3, 20);
+        for (size_t i = 0; i < length; i++) name += char(uniform(0x21, 0x7E));
+        return name;
+    }
+
+    // Words of printable characters separated by single spaces
+    std::string content(size_t min, size_t max) {
+        static constexpr std::string_view letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?'";
+        std::string text = pick(min, max, letters);
+        for (size_t i = uniform(2, 8); i + 1 < text.size(); i += uniform(2, 9)) text[i] = ' ';
+        return text;
+    }
+
+    // Roughly every tenth input is made invalid, by a bad character or by its length
+    std::string spoil(std::string text, size_t max_length) {
+        if (uniform(0, 9) != 0) return text;
+
+        if (uniform(0, 1) == 0) text[uniform(0, text.size() - 1)] = char(uniform(0, 1) == 0 ? 0x0A : 0xC3);
+        else text.resize(max_length + 1, 'x');
+        return text;
+    }
+
+    size_t uniform(size_t min, size_t max) {
+        return std::uniform_int_distribution<size_t>(min, max)(random);
+    }
+
+private:
+    std::mt19937 random;
+
+    std::string pick(size_t min, size_t max, std::string_view chars) {
+        std::string text(uniform(min, max), ' ');
+        for (char& c : text) c = chars[uniform(0, chars.size() - 1)];
+        return text;
+    }
+};
+
+template<typename T>
+static double averageSize(const std::vector<T>& items) {
+    double total = 0;
+    for (const T& item : items) total += item.size();
+    return total / items.size();
+}
+
+static std::string text(std::span<const std::byte> data) {
+    return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+static std::vector<uint8_t> binary(std::span<const std::byte> data) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    return std::vector<uint8_t>(bytes, bytes + data.size());
+}
+
+static void runAll(Runner& runner) {
+    Corpus corpus;
+    const size_t MASK = Corpus::SIZE - 1;
+    static std::array<std::byte, MAX_MESSAGE_SIZE> out;
+
+    std::vector<AuthMessage> auths;
+    std::vector<JoinMessage> joins;
+    std::vector<MsgMessage> msgs, long_msgs;
+    std::vector<ErrorMessage> errs;
+    std::vector<ReplyMessage> replies;
+    for (size_t i = 0; i < Corpus::SIZE; i++) {
+        auths.emplace_back(corpus.id(4, 20), corpus.displayName(), corpus.id(16, 40));
+        joins.emplace_back(corpus.id(4, 20), corpus.displayName());
+        msgs.emplace_back(corpus.displayName(), corpus.content(8, 200));
+        long_msgs.emplace_back(corpus.displayName(), corpus.content(1000, 1400));
+        errs.emplace_back(corpus.displayName(), corpus.content(8, 100));
+        replies.push_back(ReplyMessage{corpus.uniform(0, 3) != 0, corpus.content(8, 60), 0, uint16_t(i)});
+    }
+
+    // Wire forms of the same messages, what the receiving side parses
+    std::vector<std::string> tcp_msgs, tcp_long_msgs, tcp_errs, tcp_replies, tcp_auths, tcp_joins;
+    std::vector<std::vector<uint8_t>> udp_msgs, udp_long_msgs, udp_errs, udp_replies, udp_auths, udp_joins, udp_confirms, udp_mixed;
+    for (size_t i = 0; i < Corpus::SIZE; i++) {
+        uint16_t id = uint16_t(i * 7);
+        tcp_msgs.push_back(text({out.data(), msgs[i].serialize_into(out)}));
+        tcp_long_msgs.push_back(text({out.data(), long_msgs[i].serialize_into(out)}));
+        tcp_errs.push_back(text({out.data(), errs[i].serialize_into(out)}));
+        tcp_replies.push_back(text({out.data(), replies[i].serialize_into(out)}));
+        tcp_joins.push_back(text({out.data(), joins[i].serialize_into(out)}));
+
+        // The server's field order: AUTH {Username} AS {DisplayName} USING {Secret}
+        tcp_auths.push_back("AUTH " + auths[i].username + " AS " + auths[i].display_name + " USING " + auths[i].secret + "\r\n");
+
+        udp_msgs.push_back(binary({out.data(), msgs[i].serialize_into(out, id)}));
+        udp_long_msgs.push_back(binary({out.data(), long_msgs[i].serialize_into(out, id)}));
+        udp_errs.push_back(binary({out.data(), errs[i].serialize_into(out, id)}));
+        udp_replies.push_back(binary({out.data(), replies[i].serialize_into(out, id)}));
+        udp_auths.push_back(binary({out.data(), auths[i].serialize_into(out, id)}));
+        udp_joins.push_back(binary({out.data(), joins[i].serialize_into(out, id)}));
+        udp_confirms.push_back(binary({out.data(), ConfirmMessage(id).serialize_into(out)}));
+    }
+
+    // What a client receives: mostly MSG and CONFIRM, some REPLY, ERR, BYE and garbage
+    for (size_t i = 0; i < Corpus::SIZE; i++) {
+        size_t kind = corpus.uniform(0, 19);
+        if (kind < 10) udp_mixed.push_back(udp_msgs[i]);
+        else if (kind < 15) udp_mixed.push_back(udp_confirms[i]);
+        else if (kind < 17) udp_mixed.push_back(udp_replies[i]);
+        else if (kind == 17) udp_mixed.push_back(udp_errs[i]);
+        else if (kind == 18) udp_mixed.push_back(ByeMessage().serialize(uint16_t(i)));
+        else udp_mixed.push_back({uint8_t(corpus.uniform(0x05, 0xFD)), 0, 0});
+    }
+
+    // Frames without CRLF, as LineFramer hands them out
+    auto frames = [](const std::vector<std::string>& wire) {
+        std::vector<std::string> result;
+        for (const std::string& message : wire) result.push_back(message.substr(0, message.size() - 2));
+        return result;
+    };
+    std::vector<std::string> frame_msgs = frames(tcp_msgs), frame_long_msgs = frames(tcp_long_msgs), frame_errs = frames(tcp_errs),
+                             frame_replies = frames(tcp_replies), frame_auths = frames(tcp_auths), frame_joins = frames(tcp_joins);
+
+    std::vector<std::string> ids, secrets, names, contents, long_contents;
+    for (size_t i = 0; i < Corpus::SIZE; i++) {
+        ids.push_back(corpus.spoil(corpus.id(4, 20), 20));
+        secrets.push_back(corpus.spoil(corpus.id(16, 40), 128));
+        names.push_back(corpus.spoil(corpus.displayName(), 20));
+        contents.push_back(corpus.spoil(corpus.content(8, 200), 1400));
+        long_contents.push_back(corpus.spoil(corpus.content(1000, 1400), 1400));
+    }
+
+    // TCP serialization
+    runner.run("tcp/serialize/auth", averageSize(tcp_auths), [&](uint64_t i) { keep(auths[i & MASK].serialize()); });
+    runner.run("tcp/serialize/join", averageSize(tcp_joins), [&](uint64_t i) { keep(joins[i & MASK].serialize()); });
+    runner.run("tcp/serialize/msg", averageSize(tcp_msgs), [&](uint64_t i) { keep(msgs[i & MASK].serialize()); });
+    runner.run("tcp/serialize/msg_1400", averageSize(tcp_long_msgs), [&](uint64_t i) { keep(long_msgs[i & MASK].serialize()); });
+    runner.run("tcp/serialize/err", averageSize(tcp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize()); });
+    runner.run("tcp/serialize/bye", 5, [&](uint64_t) { keep(ByeMessage().serialize()); });
+    runner.run("tcp/serialize_into/auth", averageSize(tcp_auths), [&](uint64_t i) { keep(auths[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/join", averageSize(tcp_joins), [&](uint64_t i) { keep(joins[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/msg", averageSize(tcp_msgs), [&](uint64_t i) { keep(msgs[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/msg_1400", averageSize(tcp_long_msgs), [&](uint64_t i) { keep(long_msgs[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/err", averageSize(tcp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/reply", averageSize(tcp_replies), [&](uint64_t i) { keep(replies[i & MASK].serialize_into(out)); });
+    runner.run("tcp/serialize_into/bye", 5, [&](uint64_t) { keep(ByeMessage().serialize_into(out)); });
+
+    // UDP serialization
+    runner.run("udp/serialize/auth", averageSize(udp_auths), [&](uint64_t i) { keep(auths[i & MASK].serialize(uint16_t(i))); });
+    runner.run("udp/serialize/join", averageSize(udp_joins), [&](uint64_t i) { keep(joins[i & MASK].serialize(uint16_t(i))); });
+    runner.run("udp/serialize/msg", averageSize(udp_msgs), [&](uint64_t i) { keep(msgs[i & MASK].serialize(uint16_t(i))); });
+    runner.run("udp/serialize/msg_1400", averageSize(udp_long_msgs), [&](uint64_t i) { keep(long_msgs[i & MASK].serialize(uint16_t(i))); });
+    runner.run("udp/serialize/err", averageSize(udp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize(uint16_t(i))); });
+    runner.run("udp/serialize/err_raw", averageSize(udp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize(udp_msgs[i & MASK], uint16_t(i))); });
+    runner.run("udp/serialize/bye", 3, [&](uint64_t i) { keep(ByeMessage().serialize(uint16_t(i))); });
+    runner.run("udp/serialize/confirm", 3, [&](uint64_t i) { keep(ConfirmMessage(uint16_t(i)).serialize()); });
+    runner.run("udp/serialize_into/auth", averageSize(udp_auths), [&](uint64_t i) { keep(auths[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/join", averageSize(udp_joins), [&](uint64_t i) { keep(joins[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/msg", averageSize(udp_msgs), [&](uint64_t i) { keep(msgs[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/msg_1400", averageSize(udp_long_msgs), [&](uint64_t i) { keep(long_msgs[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/err", averageSize(udp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/err_raw", averageSize(udp_errs), [&](uint64_t i) { keep(errs[i & MASK].serialize_into(out, udp_msgs[i & MASK], uint16_t(i))); });
+    runner.run("udp/serialize_into/reply", averageSize(udp_replies), [&](uint64_t i) { keep(replies[i & MASK].serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/bye", 3, [&](uint64_t i) { keep(ByeMessage().serialize_into(out, uint16_t(i))); });
+    runner.run("udp/serialize_into/confirm", 3, [&](uint64_t i) { keep(ConfirmMessage(uint16_t(i)).serialize_into(out)); });
+
+    // TCP parsing, the old stream based deserializers and the in-place TextView
+    runner.run("tcp/deserialize/msg", averageSize(tcp_msgs), [&](uint64_t i) { keep(MsgMessage::deserialize(tcp_msgs[i & MASK])); });
+    runner.run("tcp/deserialize/msg_1400", averageSize(tcp_long_msgs), [&](uint64_t i) { keep(MsgMessage::deserialize(tcp_long_msgs[i & MASK])); });
+    runner.run("tcp/deserialize/err", averageSize(tcp_errs), [&](uint64_t i) { keep(ErrorMessage::deserialize(tcp_errs[i & MASK])); });
+    runner.run("tcp/deserialize/reply", averageSize(tcp_replies), [&](uint64_t i) { keep(ReplyMessage::deserialize(tcp_replies[i & MASK])); });
+    runner.run("tcp/parse/msg", averageSize(frame_msgs), [&](uint64_t i) { keep(TextView::parse(frame_msgs[i & MASK])); });
+    runner.run("tcp/parse/msg_1400", averageSize(frame_long_msgs), [&](uint64_t i) { keep(TextView::parse(frame_long_msgs[i & MASK])); });
+    runner.run("tcp/parse/err", averageSize(frame_errs), [&](uint64_t i) { keep(TextView::parse(frame_errs[i & MASK])); });
+    runner.run("tcp/parse/reply", averageSize(frame_replies), [&](uint64_t i) { keep(TextView::parse(frame_replies[i & MASK])); });
+    runner.run("tcp/parse/auth", averageSize(frame_auths), [&](uint64_t i) { keep(TextView::parse(frame_auths[i & MASK])); });
+    runner.run("tcp/parse/join", averageSize(frame_joins), [&](uint64_t i) { keep(TextView::parse(frame_joins[i & MASK])); });
+
+    // UDP parsing, copying deserializers and in-place views
+    runner.run("udp/deserialize/msg", averageSize(udp_msgs), [&](uint64_t i) { keep(MsgMessage::deserialize(udp_msgs[i & MASK])); });
+    runner.run("udp/deserialize/msg_1400", averageSize(udp_long_msgs), [&](uint64_t i) { keep(MsgMessage::deserialize(udp_long_msgs[i & MASK])); });
+    runner.run("udp/deserialize/err", averageSize(udp_errs), [&](uint64_t i) { keep(ErrorMessage::deserialize(udp_errs[i & MASK])); });
+    runner.run("udp/deserialize/reply", averageSize(udp_replies), [&](uint64_t i) { keep(ReplyMessage::deserialize(udp_replies[i & MASK])); });
+    runner.run("udp/deserialize/confirm", 3, [&](uint64_t i) { keep(ConfirmMessage::deserialize(udp_confirms[i & MASK])); });
+    runner.run("udp/parse/msg", averageSize(udp_msgs), [&](uint64_t i) {
+        MsgView view;
+        keep(MsgView::parse(udp_msgs[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/parse/msg_1400", averageSize(udp_long_msgs), [&](uint64_t i) {
+        MsgView view;
+        keep(MsgView::parse(udp_long_msgs[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/parse/reply", averageSize(udp_replies), [&](uint64_t i) {
+        ReplyView view;
+        keep(ReplyView::parse(udp_replies[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/parse/auth", averageSize(udp_auths), [&](uint64_t i) {
+        AuthView view;
+        keep(AuthView::parse(udp_auths[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/parse/join", averageSize(udp_joins), [&](uint64_t i) {
+        JoinView view;
+        keep(JoinView::parse(udp_joins[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/parse/confirm", 3, [&](uint64_t i) {
+        ConfirmView view;
+        keep(ConfirmView::parse(udp_confirms[i & MASK], view));
+        keep(view);
+    });
+    runner.run("udp/determine_type", averageSize(udp_mixed), [&](uint64_t i) { keep(ChatClient::determineMessageType(udp_mixed[i & MASK])); });
+
+    // Validators, about a tenth of the inputs is invalid
+    runner.run("validate/id", averageSize(ids), [&](uint64_t i) { keep(isValidId(ids[i & MASK])); });
+    runner.run("validate/secret", averageSize(secrets), [&](uint64_t i) { keep(isValidSecret(secrets[i & MASK])); });
+    runner.run("validate/dname", averageSize(names), [&](uint64_t i) { keep(isValidDName(names[i & MASK])); });
+    runner.run("validate/content", averageSize(contents), [&](uint64_t i) { keep(isValidContent(contents[i & MASK])); });
+    runner.run("validate/content_1400", averageSize(long_contents), [&](uint64_t i) { keep(isValidContent(long_contents[i & MASK])); });
+
+    // Protocol trace, one event per sent or received message
+    static TraceRing trace;
+    runner.run("trace/record", sizeof(TraceRecord), [&](uint64_t i) { trace.record(TraceEvent::SEND, 0x04, uint16_t(i), 64); });
+
+    // Transcript record handed to the writer thread, which appends to /dev/null
+    Transcript transcript("/dev/null", 0, TranscriptSync::NONE);
+    if (transcript.start()) {
+        runner.run("transcript/push", averageSize(contents), [&](uint64_t i) { keep(transcript.push(true, 0x04, names[i & MASK], contents[i & MASK])); });
+        transcript.stop();
+    }
+}
+
+// name -> ns_per_op from the CSV printed by an earlier run
+static bool loadBaseline(const std::string& path, std::unordered_map<std::string, double>& baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERR: Cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::getline(file, line); // Header
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name, iterations, ns;
+        if (std::getline(fields, name, ',') && std::getline(fields, iterations, ',') && std::getline(fields, ns, ',')) {
+            try {
+                baseline[name] = std::stod(ns);
+            } catch (const std::exception&) {}
+        }
+    }
+    return true;
+}
+
+static void printUsage() {
+    std::cerr << "usage: ipk24chat-microbench [-t <ms>] [-r <repeats>] [-b <filter>] [-c <baseline.csv>]\n";
+    std::cerr << "  -t <ms>\tMinimal duration of one timed run, default is 200.\n";
+    std::cerr << "  -r <n>\tTimed runs per case, the fastest is reported, default is 3.\n";
+    std::cerr << "  -b <filter>\tRuns only cases whose name contains filter, e.g. udp/parse.\n";
+    std::cerr << "  -c <file>\tCSV of an earlier run, adds its ns/op and the change in percent.\n";
+}
+
+static MicrobenchConfig parseArguments(int argc, char* argv[]) {
+    MicrobenchConfig config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:b:c:h")) != -1) {
+        try {
+            switch (opt) {
+                case 't': config.min_time = std::stoi(optarg); break;
+                case 'r': config.repeats = std::stoi(optarg); break;
+                case 'b': config.filter = optarg; break;
+                case 'c': config.baseline = optarg; break;
+                default: config.valid = false; return config;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "ERR: Wrong value of -" << static_cast<char>(opt) << " : " << e.what() << std::endl;
+            config.valid = false;
+            return config;
+        }
+    }
+
+    if (config.min_time < 1 || config.repeats < 1) config.valid = false;
+
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    MicrobenchConfig config = parseArguments(argc, argv);
+    if (!config.valid) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::unordered_map<std::string, double> baseline;
+    if (!config.baseline.empty() && !loadBaseline(config.baseline, baseline)) return EXIT_FAILURE;
+
+    Runner runner(config);
+    runAll(runner);
+    runner.print(baseline);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,753 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Messages.h"
+#include "LineFramer.h"
+#include "SendWindow.h"
+#include "SeenIds.h"
+#include "Reactor.h"
+#include "ValidationHelpers.h"
+
+// Reference IPK24-CHAT server for local tests and benchmarks. Speaks the TCP and the UDP
+// variant on one port, answers AUTH and JOIN, broadcasts MSG within channels and can
+// hold back its output and drop UDP datagrams to simulate a worse network.
+
+using Clock = std::chrono::steady_clock;
+
+struct ServerConfig {
+    std::string address = "127.0.0.1";
+    unsigned short port = 4567;
+    int delay = 0;     // Milliseconds every outgoing message is held back
+    double loss = 0;   // Probability a UDP datagram is dropped, in both directions
+    int timeout = 250; // UDP confirmation timeout in milliseconds
+    int retries = 3;   // UDP retransmissions
+    unsigned seed = 1;
+    bool valid = true;
+};
+
+static const std::string DEFAULT_CHANNEL = "general";
+static const std::string SERVER_NAME = "Server";
+
+class Server;
+
+// One connected client, TCP or UDP
+class User {
+public:
+    User(Server& server, uint64_t id, int fd) : id(id), fd(fd), server(server) {}
+    virtual ~User() {
+        if (fd != -1) close(fd);
+    }
+
+    virtual void onReadable() = 0;
+    virtual void onWritable() {}
+    virtual void tick(Clock::time_point) {}
+
+    virtual void sendMsg(std::string_view display_name, std::string_view content) = 0;
+    virtual void sendReply(bool success, std::string_view content, uint16_t ref_mid) = 0;
+    virtual void sendErr(std::string_view content) = 0;
+    virtual void sendBye() = 0;
+
+    // Nothing waits to be written or confirmed
+    virtual bool drained() const = 0;
+    // Can be removed, called only once closing is set
+    virtual bool removable(Clock::time_point) const {
+        return drained();
+    }
+
+    const uint64_t id;
+    const int fd;
+    bool authenticated = false;
+    bool closing = false; // Removed once everything was sent
+    bool dead = false;    // Connection is gone, removed right away
+    Clock::time_point closed_at;
+    std::string display_name, channel;
+
+protected:
+    Server& server;
+};
+
+class Server : public EventHandler {
+public:
+    Server(const ServerConfig& config, Reactor& reactor)
+    : config(config), reactor(reactor), random(config.seed) {}
+
+    ~Server() override {
+        users.clear();
+        if (tcp_fd != -1) close(tcp_fd);
+        if (udp_fd != -1) close(udp_fd);
+        if (timer_fd != -1) close(timer_fd);
+    }
+
+    bool start();
+
+    void onEvent(int fd, uint32_t events) override;
+    void afterEvents() override;
+
+    // Protocol, shared by both variants
+    void handleAuth(User& user, std::string_view username, std::string_view display_name, std::string_view secret, uint16_t ref_mid);
+    void handleJoin(User& user, std::string_view channel, std::string_view display_name, uint16_t ref_mid);
+    void handleMsg(User& user, std::string_view display_name, std::string_view content);
+    void handleErr(User& user);
+    void handleBye(User& user);
+    void handleMalformed(User& user, std::string_view reason);
+    void handleGone(User& user); // Connection was lost
+
+    // Runs action on the user after the artificial delay, if the user still exists
+    void later(uint64_t user_id, std::function<void(User&)> action);
+    bool lose(); // Whether this UDP datagram gets lost
+
+    std::span<std::byte> scratch() { return buffer; }
+    Reactor& events() { return reactor; }
+    const ServerConfig& config;
+
+private:
+    struct Delayed {
+        Clock::time_point due;
+        uint64_t seq; // Keeps the order of actions with the same due time
+        uint64_t user_id;
+        std::function<void(User&)> action;
+
+        bool operator>(const Delayed& other) const {
+            return due != other.due ? due > other.due : seq > other.seq;
+        }
+    };
+
+    Reactor& reactor;
+    int tcp_fd = -1, udp_fd = -1, timer_fd = -1;
+    bool timer_armed = false;
+    uint64_t next_id = 1, next_seq = 0;
+
+    std::unordered_map<uint64_t, std::unique_ptr<User>> users;
+    std::unordered_map<int, User*> by_fd;
+    std::unordered_map<uint64_t, User*> udp_by_addr; // Sender address of the first AUTH
+    std::priority_queue<Delayed, std::vector<Delayed>, std::greater<Delayed>> delayed;
+    std::mt19937 random;
+    std::array<std::byte, MAX_MESSAGE_SIZE> buffer;
+
+    void acceptTcp();
+    void receiveWelcome();
+    void addUser(std::unique_ptr<User> user);
+    void removeUser(User& user);
+    void joinChannel(User& user, const std::string& channel);
+    void leaveChannel(User& user);
+    void broadcast(const std::string& channel, std::string_view content, const User* except);
+    void armTimer(bool needed);
+};
+
+// TCP client, output waits in a buffer while the socket is full
+class TcpUser : public User {
+public:
+    TcpUser(Server& server, uint64_t id, int fd) : User(server, id, fd), framer(std::make_unique<LineFramer>()) {}
+
+    void onReadable() override {
+        ssize_t bytes = recv(fd, framer->writePtr(), framer->writable(), MSG_DONTWAIT);
+        if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EINTR)) {
+            server.handleGone(*this);
+            return;
+        }
+        if (bytes < 0) return;
+
+        framer->commit(bytes);
+
+        std::string_view frame;
+        while (!closing && framer->nextFrame(frame)) {
+            TextView message = TextView::parse(frame);
+            switch (message.type) {
+                case MessageType::AUTH:
+                    server.handleAuth(*this, message.username, message.display_name, message.secret, 0);
+                    break;
+                case MessageType::JOIN:
+                    server.handleJoin(*this, message.channel_id, message.display_name, 0);
+                    break;
+                case MessageType::MSG:
+                    server.handleMsg(*this, message.display_name, message.message_content);
+                    break;
+                case MessageType::ERR:
+                    server.handleErr(*this);
+                    break;
+                case MessageType::BYE:
+                    server.handleBye(*this);
+                    break;
+                default:
+                    server.handleMalformed(*this, "Malformed message.");
+                    break;
+            }
+        }
+
+        if (framer->overflow()) server.handleMalformed(*this, "Message too long.");
+    }
+
+    void onWritable() override {
+        flush();
+    }
+
+    void sendMsg(std::string_view display_name, std::string_view content) override {
+        MsgMessage message{std::string(display_name), std::string(content)};
+        queue(message.serialize_into(server.scratch()));
+    }
+
+    void sendReply(bool success, std::string_view content, uint16_t) override {
+        ReplyMessage message{success, std::string(content), 0, 0};
+        queue(message.serialize_into(server.scratch()));
+    }
+
+    void sendErr(std::string_view content) override {
+        ErrorMessage message(SERVER_NAME, std::string(content));
+        queue(message.serialize_into(server.scratch()));
+    }
+
+    void sendBye() override {
+        queue(ByeMessage().serialize_into(server.scratch()));
+    }
+
+    bool drained() const override {
+        return output.empty();
+    }
+
+private:
+    std::unique_ptr<LineFramer> framer;
+    std::string output;
+    bool waiting_for_writable = false;
+
+    void queue(size_t length) {
+        std::string data(reinterpret_cast<const char*>(server.scratch().data()), length);
+        server.later(id, [data = std::move(data)](User& user) {
+            static_cast<TcpUser&>(user).write(data);
+        });
+    }
+
+    void write(std::string_view data) {
+        if (dead) return;
+        output.append(data);
+        flush();
+    }
+
+    void flush() {
+        size_t sent = 0;
+        while (sent < output.size()) {
+            ssize_t bytes = send(fd, output.data() + sent, output.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN) {
+                    server.handleGone(*this);
+                    output.clear();
+                    return;
+                }
+                break;
+            }
+            sent += bytes;
+        }
+        output.erase(0, sent);
+
+        // Waits for EPOLLOUT only while something is left
+        if (output.empty() == waiting_for_writable) {
+            waiting_for_writable = !output.empty();
+            server.events().modify(fd, waiting_for_writable ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        }
+    }
+};
+
+// UDP client on its own socket (dynamic port), messages are confirmed and retransmitted
+class UdpUser : public User {
+public:
+    static constexpr uint16_t WINDOW = 64; // Unconfirmed messages, the rest waits in the backlog
+
+    UdpUser(Server& server, uint64_t id, int fd, const struct sockaddr_in& addr)
+    : User(server, id, fd), addr(addr), window(WINDOW) {}
+
+    void onReadable() override {
+        uint8_t data[4096];
+        while (true) {
+            struct sockaddr_in sender;
+            socklen_t length = sizeof(sender);
+            ssize_t bytes = recvfrom(fd, data, sizeof(data), MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&sender), &length);
+            if (bytes < 0) return;
+
+            if (sender.sin_addr.s_addr != addr.sin_addr.s_addr || sender.sin_port != addr.sin_port) continue;
+            if (server.lose()) continue;
+
+            handleDatagram(std::span<const uint8_t>(data, bytes));
+        }
+    }
+
+    void handleDatagram(std::span<const uint8_t> data) {
+        uint16_t mid;
+        if (!udp_view::readId(data, mid)) return;
+
+        if (data[0] == 0x00) {
+            window.confirm(mid);
+            refill();
+            return;
+        }
+
+        // Every message is confirmed, duplicates are not processed again
+        size_t length = ConfirmMessage(mid).serialize_into(server.scratch());
+        std::vector<std::byte> confirm(server.scratch().begin(), server.scratch().begin() + length);
+        server.later(id, [confirm = std::move(confirm)](User& user) {
+            static_cast<UdpUser&>(user).transmit(confirm);
+        });
+
+        if (!seen.insert(mid) || (closing && !dead)) return;
+
+        switch (data[0]) {
+            case 0x02: {
+                AuthView view;
+                if (AuthView::parse(data, view)) server.handleAuth(*this, view.username, view.display_name, view.secret, mid);
+                else server.handleMalformed(*this, "Malformed AUTH.");
+                break;
+            }
+            case 0x03: {
+                JoinView view;
+                if (JoinView::parse(data, view)) server.handleJoin(*this, view.channel_id, view.display_name, mid);
+                else server.handleMalformed(*this, "Malformed JOIN.");
+                break;
+            }
+            case 0x04: {
+                MsgView view;
+                if (MsgView::parse(data, view)) server.handleMsg(*this, view.display_name, view.message_content);
+                else server.handleMalformed(*this, "Malformed MSG.");
+                break;
+            }
+            case 0xFE:
+                server.handleErr(*this);
+                break;
+            case 0xFF:
+                server.handleBye(*this);
+                break;
+            default:
+                server.handleMalformed(*this, "Unknown message type.");
+                break;
+        }
+    }
+
+    void tick(Clock::time_point now) override {
+        bool failed = false;
+        window.forEach([&](uint16_t, TimedMessage& message) {
+            if (failed || message.deadline > now) return;
+
+            if (message.retry_count >= server.config.retries) {
+                failed = true;
+                return;
+            }
+
+            message.retry_count++;
+            message.deadline = now + std::chrono::milliseconds(server.config.timeout);
+            transmit(std::as_bytes(std::span(message.message_data)));
+        });
+
+        // Client stopped confirming
+        if (failed) {
+            server.handleGone(*this);
+            window = SendWindow(WINDOW);
+            backlog.clear();
+        }
+    }
+
+    void sendMsg(std::string_view display_name, std::string_view content) override {
+        MsgMessage message{std::string(display_name), std::string(content)};
+        track(message.serialize_into(server.scratch(), next_mid++));
+    }
+
+    void sendReply(bool success, std::string_view content, uint16_t ref_mid) override {
+        ReplyMessage message{success, std::string(content), 0, ref_mid};
+        track(message.serialize_into(server.scratch(), next_mid++));
+    }
+
+    void sendErr(std::string_view content) override {
+        ErrorMessage message(SERVER_NAME, std::string(content));
+        track(message.serialize_into(server.scratch(), next_mid++));
+    }
+
+    void sendBye() override {
+        track(ByeMessage().serialize_into(server.scratch(), next_mid++));
+    }
+
+    bool pending() const {
+        return !window.empty() || !backlog.empty();
+    }
+
+    bool drained() const override {
+        return !pending();
+    }
+
+    // Stays a while after the end, so that retransmitted BYE or ERR are still confirmed
+    bool removable(Clock::time_point now) const override {
+        auto linger = std::chrono::milliseconds(server.config.timeout) * (server.config.retries + 1);
+        return dead || (drained() && now - closed_at >= linger);
+    }
+
+    const struct sockaddr_in addr;
+
+private:
+    SendWindow window;
+    std::deque<std::pair<uint16_t, std::vector<std::byte>>> backlog;
+    SeenIds seen;
+    uint16_t next_mid = 0;
+
+    // Message that has to be confirmed, sent after the delay
+    void track(size_t length) {
+        uint16_t mid = static_cast<uint16_t>(next_mid - 1);
+        std::vector<std::byte> data(server.scratch().begin(), server.scratch().begin() + length);
+        server.later(id, [mid, data = std::move(data)](User& user) mutable {
+            UdpUser& udp = static_cast<UdpUser&>(user);
+            udp.backlog.emplace_back(mid, std::move(data));
+            udp.refill();
+        });
+    }
+
+    // Moves messages from the backlog to the window and sends them
+    void refill() {
+        while (!backlog.empty()) {
+            auto& [mid, data] = backlog.front();
+            auto now = Clock::now();
+            if (!window.push(mid, data, now, now + std::chrono::milliseconds(server.config.timeout))) break;
+            transmit(data);
+            backlog.pop_front();
+        }
+    }
+
+    void transmit(std::span<const std::byte> data) {
+        if (dead || server.lose()) return;
+        sendto(fd, data.data(), data.size(), 0, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(addr));
+    }
+};
+
+bool Server::start() {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "ERR: Invalid address " << config.address << std::endl;
+        return false;
+    }
+
+    int reuse = 1;
+    tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tcp_fd == -1 || udp_fd == -1 || timer_fd == -1) {
+        std::cerr << "ERR: socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(tcp_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1 || listen(tcp_fd, SOMAXCONN) == -1
+        || bind(udp_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+        std::cerr << "ERR: bind: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!reactor.add(tcp_fd, EPOLLIN, this) || !reactor.add(udp_fd, EPOLLIN, this) || !reactor.add(timer_fd, EPOLLIN, this)) {
+        std::cerr << "ERR: epoll_ctl: " << strerror(errno) << std::endl;
+        return false;
+    }
+    reactor.attach(this);
+
+    std::cerr << "Listening on " << config.address << ":" << config.port << " (TCP and UDP)" << std::endl;
+    return true;
+}
+
+void Server::onEvent(int fd, uint32_t events) {
+    if (fd == tcp_fd) {
+        acceptTcp();
+    } else if (fd == udp_fd) {
+        receiveWelcome();
+    } else if (fd == timer_fd) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0) return;
+
+        auto now = Clock::now();
+        while (!delayed.empty() && delayed.top().due <= now) {
+            Delayed entry = delayed.top();
+            delayed.pop();
+            auto user = users.find(entry.user_id);
+            if (user != users.end()) entry.action(*user->second);
+        }
+
+        for (auto& [id, user] : users) user->tick(now);
+    } else {
+        auto user = by_fd.find(fd);
+        if (user == by_fd.end()) return;
+
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) user->second->onReadable();
+        if ((events & EPOLLOUT) && !user->second->dead) user->second->onWritable();
+    }
+}
+
+void Server::afterEvents() {
+    auto now = Clock::now();
+    bool retransmitting = false;
+
+    std::vector<User*> gone;
+    for (auto& [id, user] : users) {
+        if (user->dead || (user->closing && user->removable(now))) gone.push_back(user.get());
+        else if (auto udp = dynamic_cast<UdpUser*>(user.get()); udp != nullptr && (udp->pending() || udp->closing)) retransmitting = true;
+    }
+    for (User* user : gone) removeUser(*user);
+
+    armTimer(retransmitting || !delayed.empty());
+}
+
+void Server::armTimer(bool needed) {
+    if (needed == timer_armed) return;
+
+    // 1 ms ticks drive the delayed output and retransmissions
+    struct itimerspec spec = {};
+    if (needed) spec.it_value.tv_nsec = spec.it_interval.tv_nsec = 1000000;
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+    timer_armed = needed;
+}
+
+void Server::acceptTcp() {
+    while (true) {
+        int fd = accept4(tcp_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) return;
+
+        addUser(std::make_unique<TcpUser>(*this, next_id++, fd));
+    }
+}
+
+void Server::receiveWelcome() {
+    uint8_t data[4096];
+    while (true) {
+        struct sockaddr_in sender;
+        socklen_t length = sizeof(sender);
+        ssize_t bytes = recvfrom(udp_fd, data, sizeof(data), MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&sender), &length);
+        if (bytes < 0) return;
+        if (bytes < 3 || lose()) continue;
+
+        // Retransmitted AUTH whose CONFIRM was lost goes to the user it created
+        uint64_t key = static_cast<uint64_t>(sender.sin_addr.s_addr) << 16 | sender.sin_port;
+        auto known = udp_by_addr.find(key);
+        if (known != udp_by_addr.end()) {
+            static_cast<UdpUser*>(known->second)->handleDatagram(std::span<const uint8_t>(data, bytes));
+            continue;
+        }
+        if (data[0] != 0x02) continue; // Sessions start with AUTH
+
+        // Client talks to a new port from now on
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        struct sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        inet_pton(AF_INET, config.address.c_str(), &local.sin_addr);
+        if (fd == -1 || bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) == -1) {
+            if (fd != -1) close(fd);
+            continue;
+        }
+
+        auto user = std::make_unique<UdpUser>(*this, next_id++, fd, sender);
+        UdpUser* udp = user.get();
+        udp_by_addr[key] = udp;
+        addUser(std::move(user));
+        udp->handleDatagram(std::span<const uint8_t>(data, bytes));
+    }
+}
+
+void Server::addUser(std::unique_ptr<User> user) {
+    if (!reactor.add(user->fd, EPOLLIN, this)) return;
+
+    by_fd[user->fd] = user.get();
+    users[user->id] = std::move(user);
+}
+
+void Server::removeUser(User& user) {
+    if (user.authenticated && !user.dead && !user.closing) leaveChannel(user);
+
+    if (auto udp = dynamic_cast<UdpUser*>(&user)) {
+        udp_by_addr.erase(static_cast<uint64_t>(udp->addr.sin_addr.s_addr) << 16 | udp->addr.sin_port);
+    }
+
+    reactor.remove(user.fd);
+    by_fd.erase(user.fd);
+    users.erase(user.id);
+}
+
+void Server::later(uint64_t user_id, std::function<void(User&)> action) {
+    if (config.delay == 0) {
+        auto user = users.find(user_id);
+        if (user != users.end()) action(*user->second);
+        return;
+    }
+
+    delayed.push({Clock::now() + std::chrono::milliseconds(config.delay), next_seq++, user_id, std::move(action)});
+}
+
+bool Server::lose() {
+    if (config.loss <= 0) return false;
+    return std::uniform_real_distribution<double>(0, 1)(random) < config.loss;
+}
+
+void Server::joinChannel(User& user, const std::string& channel) {
+    user.channel = channel;
+    broadcast(channel, user.display_name + " has joined " + channel + ".", nullptr);
+}
+
+void Server::leaveChannel(User& user) {
+    if (user.channel.empty()) return;
+
+    std::string channel = std::move(user.channel);
+    user.channel.clear();
+    broadcast(channel, user.display_name + " has left " + channel + ".", &user);
+}
+
+void Server::broadcast(const std::string& channel, std::string_view content, const User* except) {
+    for (auto& [id, user] : users) {
+        if (user.get() == except || !user->authenticated || user->closing || user->dead || user->channel != channel) continue;
+        user->sendMsg(SERVER_NAME, content);
+    }
+}
+
+void Server::handleAuth(User& user, std::string_view username, std::string_view display_name, std::string_view secret, uint16_t ref_mid) {
+    if (user.authenticated) {
+        user.sendReply(false, "Already authenticated.", ref_mid);
+        return;
+    }
+
+    if (!isValidId(username) || !isValidDName(display_name) || !isValidSecret(secret)) {
+        user.sendReply(false, "Invalid credentials.", ref_mid);
+        return;
+    }
+
+    user.authenticated = true;
+    user.display_name = display_name;
+    user.sendReply(true, "Auth success.", ref_mid);
+    joinChannel(user, DEFAULT_CHANNEL);
+}
+
+void Server::handleJoin(User& user, std::string_view channel, std::string_view display_name, uint16_t ref_mid) {
+    if (!user.authenticated) {
+        handleMalformed(user, "Not authenticated.");
+        return;
+    }
+
+    if (!isValidId(channel) || !isValidDName(display_name)) {
+        user.sendReply(false, "Invalid channel.", ref_mid);
+        return;
+    }
+
+    user.display_name = display_name;
+    leaveChannel(user);
+    user.sendReply(true, "Join success.", ref_mid);
+    joinChannel(user, std::string(channel));
+}
+
+void Server::handleMsg(User& user, std::string_view display_name, std::string_view content) {
+    if (!user.authenticated) {
+        handleMalformed(user, "Not authenticated.");
+        return;
+    }
+
+    if (!isValidDName(display_name) || !isValidContent(content)) {
+        handleMalformed(user, "Invalid message.");
+        return;
+    }
+
+    user.display_name = display_name;
+    for (auto& [id, other] : users) {
+        if (other.get() == &user || !other->authenticated || other->closing || other->dead || other->channel != user.channel) continue;
+        other->sendMsg(display_name, content);
+    }
+}
+
+void Server::handleErr(User& user) {
+    leaveChannel(user);
+    user.sendBye();
+    later(user.id, [](User& closed) {
+        closed.closing = true;
+        closed.closed_at = Clock::now();
+    });
+}
+
+void Server::handleBye(User& user) {
+    leaveChannel(user);
+    user.closing = true;
+    user.closed_at = Clock::now();
+}
+
+void Server::handleMalformed(User& user, std::string_view reason) {
+    user.sendErr(reason);
+    handleErr(user);
+}
+
+void Server::handleGone(User& user) {
+    if (user.dead) return;
+
+    leaveChannel(user);
+    user.dead = true;
+}
+
+static void printUsage() {
+    std::cerr << "usage: ipk24chat-server [-a <address>] [-p <port>] [-D <delay_ms>] [-L <loss>] [-d <udp_timeout>] [-r <udp_retransmissions>] [-S <seed>]\n";
+    std::cerr << "  -a <address>\tIPv4 address to listen on, default is 127.0.0.1.\n";
+    std::cerr << "  -p <port>\tTCP and UDP port, default is 4567.\n";
+    std::cerr << "  -D <ms>\tDelay of every outgoing message, default is 0.\n";
+    std::cerr << "  -L <loss>\tProbability 0-1 that a UDP datagram is dropped, in both directions, default is 0.\n";
+    std::cerr << "  -d <ms>\tUDP confirmation timeout, default is 250.\n";
+    std::cerr << "  -r <n>\tUDP retransmissions, default is 3.\n";
+    std::cerr << "  -S <seed>\tSeed of the loss generator, default is 1.\n";
+}
+
+static ServerConfig parseArguments(int argc, char* argv[]) {
+    ServerConfig config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:D:L:d:r:S:h")) != -1) {
+        try {
+            switch (opt) {
+                case 'a': config.address = optarg; break;
+                case 'p': config.port = std::stoi(optarg); break;
+                case 'D': config.delay = std::stoi(optarg); break;
+                case 'L': config.loss = std::stod(optarg); break;
+                case 'd': config.timeout = std::stoi(optarg); break;
+                case 'r': config.retries = std::stoi(optarg); break;
+                case 'S': config.seed = std::stoul(optarg); break;
+                default: config.valid = false; return config;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "ERR: Wrong value of -" << static_cast<char>(opt) << " : " << e.what() << std::endl;
+            config.valid = false;
+            return config;
+        }
+    }
+
+    if (config.delay < 0 || config.loss < 0 || config.loss > 1 || config.timeout < 1 || config.retries < 0) config.valid = false;
+
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    ServerConfig config = parseArguments(argc, argv);
+    if (!config.valid) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Reactor reactor;
+    if (!reactor.valid()) return EXIT_FAILURE;
+
+    Server server(config, reactor);
+    if (!server.start()) return EXIT_FAILURE;
+
+    return reactor.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TraceRing.h"
+#include "CommandQueue.h"
+
+// Prints a protocol trace written by /trace or on a fatal error as text, one event per line:
+// time since the first event, time since the previous one, event, message type, MessageID, value.
+
+static const char* eventName(uint8_t event) {
+    switch (static_cast<TraceEvent>(event)) {
+        case TraceEvent::SEND:       return "SEND";
+        case TraceEvent::RECV:       return "RECV";
+        case TraceEvent::CONFIRM:    return "CONFIRM";
+        case TraceEvent::RETRANSMIT: return "RETRANSMIT";
+        case TraceEvent::GIVE_UP:    return "GIVE_UP";
+        case TraceEvent::STATE:      return "STATE";
+        case TraceEvent::DEQUEUE:    return "DEQUEUE";
+        case TraceEvent::RECONNECT:  return "RECONNECT";
+        default:                     return "?";
+    }
+}
+
+static const char* typeName(uint8_t type) {
+    switch (type) {
+        case 0x00: return "CONFIRM";
+        case 0x01: return "REPLY";
+        case 0x02: return "AUTH";
+        case 0x03: return "JOIN";
+        case 0x04: return "MSG";
+        case 0xFE: return "ERR";
+        case 0xFF: return "BYE";
+        default:   return "UNKNOWN";
+    }
+}
+
+static const char* commandName(uint8_t type) {
+    switch (static_cast<CommandType>(type)) {
+        case CommandType::AUTH:    return "/auth";
+        case CommandType::JOIN:    return "/join";
+        case CommandType::RENAME:  return "/rename";
+        case CommandType::HELP:    return "/help";
+        case CommandType::LATENCY: return "/latency";
+        case CommandType::STATS:   return "/stats";
+        case CommandType::TRACE:   return "/trace";
+        case CommandType::MSG:     return "message";
+        default:                   return "invalid";
+    }
+}
+
+static std::string stateNames(uint32_t state) {
+    static const std::pair<uint32_t, const char*> FLAGS[] = {
+        {trace_state::WAITING_FOR_AUTH, "waiting_for_auth"}, {trace_state::WAITING_FOR_RESPONSE, "waiting_for_response"},
+        {trace_state::WINDOW_FULL, "window_full"}, {trace_state::INPUT_BLOCKED, "input_blocked"},
+        {trace_state::BYE, "bye"}, {trace_state::ERR, "err"}, {trace_state::DONE, "done"},
+        {trace_state::RECONNECTING, "reconnecting"},
+    };
+
+    std::string names;
+    for (const auto& [bit, name] : FLAGS) {
+        if (!(state & bit)) continue;
+        if (!names.empty()) names += '|';
+        names += name;
+    }
+    return names.empty() ? "idle" : names;
+}
+
+static void printRecord(const TraceRecord& record) {
+    switch (static_cast<TraceEvent>(record.event)) {
+        case TraceEvent::SEND:
+        case TraceEvent::RECV:
+            std::cout << std::setw(8) << typeName(record.type) << "  id=" << record.id << " bytes=" << record.value;
+            break;
+        case TraceEvent::CONFIRM:
+            std::cout << std::setw(8) << typeName(record.type) << "  id=" << record.id;
+            if (record.value == TRACE_UNEXPECTED) std::cout << " unexpected";
+            else std::cout << " after_us=" << record.value;
+            break;
+        case TraceEvent::RETRANSMIT:
+        case TraceEvent::GIVE_UP:
+            std::cout << std::setw(8) << typeName(record.type) << "  id=" << record.id << " retry=" << record.value;
+            break;
+        case TraceEvent::STATE:
+            std::cout << std::setw(8) << "" << "  " << stateNames(record.value);
+            break;
+        case TraceEvent::DEQUEUE:
+            std::cout << std::setw(8) << commandName(record.type) << "  left=" << record.value;
+            break;
+        case TraceEvent::RECONNECT:
+            std::cout << std::setw(8) << "" << "  attempt=" << record.value << (record.type ? " connected" : " failed");
+            break;
+        default:
+            std::cout << std::setw(8) << int(record.type) << "  id=" << record.id << " value=" << record.value;
+            break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 || std::string(argv[1]) == "-h") {
+        std::cerr << "usage: ipk24chat-tracedump <trace_file>\n";
+        return EXIT_FAILURE;
+    }
+
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    if (!TraceRing::load(argv[1], header, records)) {
+        std::cerr << "ERR: " << argv[1] << " is not a readable ipk24chat trace" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "# " << header.records << " events, " << header.recorded - header.records << " older ones overwritten\n";
+    std::cout << "#   time_ms    delta_us  event         type  details\n";
+    std::cout << std::fixed;
+
+    uint64_t first = records.empty() ? 0 : records.front().time;
+    uint64_t previous = first;
+    for (const TraceRecord& record : records) {
+        std::cout << std::setw(11) << std::setprecision(3) << (record.time - first) / 1e6 << ' '
+                  << std::setw(11) << std::setprecision(1) << (record.time - previous) / 1e3 << "  "
+                  << std::left << std::setw(10) << eventName(record.event) << std::right << ' ';
+        printRecord(record);
+        std::cout << '\n';
+        previous = record.time;
+    }
+
+    return EXIT_SUCCESS;
+}